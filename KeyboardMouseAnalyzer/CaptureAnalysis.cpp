@@ -0,0 +1,548 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CaptureAnalysis.cpp : Provides the parallel analysis of capture files - per key statistics,
+//                       latency distributions, pattern hits and mouse trajectories.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "CaptureAnalysis.h"
+#include "KeyNames.h"
+
+#include <windowsx.h>
+
+#define MAX_CHUNK_MATCHES 16
+
+// What a chunk leaves a key as
+#define KEY_SAME 0                      // No message for the key
+#define KEY_UP 1
+#define KEY_DOWN 2                      // Pressed after it was released, at keyTime
+#define KEY_DOWN_IF_UP 3                // Pressed at keyTime unless it was already down
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Merge another histogram into this one
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LatencyHistogram::Merge(const LatencyHistogram& other)
+{
+	for (UINT i = 0; i < LATENCY_BUCKETS; i++) _count[i] += other._count[i];
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The number of values added
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ULONGLONG LatencyHistogram::Total() const
+{
+	ULONGLONG total = 0;
+	for (UINT i = 0; i < LATENCY_BUCKETS; i++) total += _count[i];
+	return total;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The lower bound of the bucket holding the given fraction of the values, in thousandths
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ULONGLONG LatencyHistogram::Percentile(UINT permille) const
+{
+	ULONGLONG total = Total();
+	if (total == 0) return 0;
+
+	ULONGLONG rank = (total * permille + 999) / 1000;
+	if (rank == 0) rank = 1;
+	ULONGLONG seen = 0;
+	for (UINT i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		seen += _count[i];
+		if (seen >= rank) return BucketLow(i);
+	}
+	return BucketLow(LATENCY_BUCKETS - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Compare histograms
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL LatencyHistogram::operator==(const LatencyHistogram& other) const
+{
+	return memcmp(_count, other._count, sizeof(_count)) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The bucket of a value: the value itself below 8, then the power of two and the next two bits
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT LatencyHistogram::Bucket(ULONGLONG value)
+{
+	if (value < 8) return (UINT)value;
+	UINT log2 = 63;
+	while (!(value >> log2)) log2--;
+	return (log2 - 1) * 4 + (UINT)((value >> (log2 - 2)) & 3);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The smallest value of a bucket
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ULONGLONG LatencyHistogram::BucketLow(UINT bucket)
+{
+	if (bucket < 8) return bucket;
+	return (ULONGLONG)(4 + bucket % 4) << (bucket / 4 - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Clear the aggregate for the given number of pattern rules
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void CaptureAggregate::Reset(UINT cRules)
+{
+	events = 0;
+	ZeroMemory(messages, sizeof(messages));
+	unmatchedUps = 0;
+	ZeroMemory(key, sizeof(key));
+	hold.Reset();
+	press.Reset();
+	move.Reset();
+	hits.assign(cRules, PatternHits{ 0, (ULONGLONG)-1 });
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Merge a partial result into this one
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void CaptureAggregate::Merge(const CaptureAggregate& other)
+{
+	events += other.events;
+	for (UINT i = 0; i <= MESSAGE_SLOTS; i++) messages[i] += other.messages[i];
+	unmatchedUps += other.unmatchedUps;
+	for (UINT k = 0; k < ANALYSIS_KEYS; k++)
+	{
+		KeyStats& ks = key[k];
+		const KeyStats& o = other.key[k];
+		ks.downs += o.downs;
+		ks.repeats += o.repeats;
+		ks.ups += o.ups;
+		ks.chars += o.chars;
+		ks.holds += o.holds;
+		ks.holdSum += o.holdSum;
+		if (o.holdMax > ks.holdMax) ks.holdMax = o.holdMax;
+	}
+	hold.Merge(other.hold);
+	press.Merge(other.press);
+	move.Merge(other.move);
+	for (size_t r = 0; r < hits.size() && r < other.hits.size(); r++)
+	{
+		hits[r].count += other.hits[r].count;
+		if (other.hits[r].firstEvent < hits[r].firstEvent) hits[r].firstEvent = other.hits[r].firstEvent;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Compare results
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL CaptureAggregate::operator==(const CaptureAggregate& other) const
+{
+	if (events != other.events || unmatchedUps != other.unmatchedUps) return false;
+	if (memcmp(messages, other.messages, sizeof(messages)) || memcmp(key, other.key, sizeof(key))) return false;
+	if (!(hold == other.hold) || !(press == other.press) || !(move == other.move)) return false;
+	if (hits.size() != other.hits.size()) return false;
+	for (size_t r = 0; r < hits.size(); r++)
+	{
+		if (hits[r].count != other.hits[r].count || hits[r].firstEvent != other.hits[r].firstEvent) return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+CaptureAnalysis::CaptureAnalysis()
+{
+	_pDetector = NULL;
+	_chunkEvents = DEFAULT_CHUNK_EVENTS;
+	_events = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Map a capture file for analysis - Files are analyzed in the order added
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL CaptureAnalysis::AddFile(const TCHAR* pszPath)
+{
+	std::unique_ptr<CaptureFile> pFile(new CaptureFile);
+	if (!pFile->Open(pszPath)) return false;
+	_events += pFile->Count();
+	_files.push_back(std::move(pFile));
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The key index of a keyboard message: its scan code with the 0xE0 prefix in bit 8
+///////////////////////////////////////////////////////////////////////////////////////////////////
+WORD CaptureAnalysis::KeyIndex(LPARAM lParam)
+{
+	return MAKEKEYSYMBOL(ExtendedScanCode(lParam), 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The extended scan code of a key index, for ScanCodeName()
+///////////////////////////////////////////////////////////////////////////////////////////////////
+WORD CaptureAnalysis::KeyScanCode(WORD key)
+{
+	return key & 0x100 ? MAKEWORD(key & 0xFF, 0xE0) : key & 0xFF;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// First pass - How the chunk changes the state, without knowing the state at its start
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void CaptureAnalysis::Summarize(const Chunk& chunk, Summary* pSummary) const
+{
+	Summary& s = *pSummary;
+	s = Summary();
+
+	for (UINT i = 0; i < chunk.cRecords; i++)
+	{
+		const CaptureRecord& cr = chunk.pRecords[i];
+		switch (cr.message)
+		{
+		case WM_KEYDOWN:
+		case WM_SYSKEYDOWN:
+		{
+			if (cr.source >= MAX_SOURCES) break;
+			if (s.keys.size() <= cr.source) s.keys.resize(cr.source + 1);
+			KeySummary& ks = s.keys[cr.source];
+
+			WORD k = KeyIndex((LPARAM)cr.lParam);
+			if (ks.keyEffect[k] == KEY_SAME || ks.keyEffect[k] == KEY_UP)
+			{
+				ks.keyEffect[k] = ks.keyEffect[k] == KEY_UP ? KEY_DOWN : KEY_DOWN_IF_UP;
+				ks.keyTime[k] = cr.timestamp;
+			}
+
+			UINT modifier = PatternDetector::ModifierOf((WPARAM)cr.wParam);
+			if (modifier)
+			{
+				ks.modifierSet |= modifier;
+				ks.modifierClear &= ~modifier;
+			}
+			else if (!(HIWORD(cr.lParam) & KF_REPEAT))
+			{
+				Press& press = ks.press[ks.cPresses++ & (MAX_PATTERN_LEN - 1)];
+				press.key = k;
+				press.touched = (BYTE)(ks.modifierSet | ks.modifierClear);
+				press.modifiers = (BYTE)ks.modifierSet;
+				press.timestamp = cr.timestamp;
+			}
+		}
+		break;
+
+		case WM_KEYUP:
+		case WM_SYSKEYUP:
+		{
+			if (cr.source >= MAX_SOURCES) break;
+			if (s.keys.size() <= cr.source) s.keys.resize(cr.source + 1);
+			KeySummary& ks = s.keys[cr.source];
+
+			ks.keyEffect[KeyIndex((LPARAM)cr.lParam)] = KEY_UP;
+			UINT modifier = PatternDetector::ModifierOf((WPARAM)cr.wParam);
+			ks.modifierClear |= modifier;
+			ks.modifierSet &= ~modifier;
+		}
+		break;
+
+		case WM_MOUSEMOVE:
+			if (cr.source < MAX_SOURCES)
+			{
+				s.hasMove[cr.source] = true;
+				s.moveTime[cr.source] = cr.timestamp;
+			}
+			break;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Carry the state at the start of a chunk to its end
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void CaptureAnalysis::Apply(const Summary& summary, State* pState)
+{
+	State& state = *pState;
+	if (state.keys.size() < summary.keys.size()) state.keys.resize(summary.keys.size());
+	for (size_t source = 0; source < summary.keys.size(); source++)
+	{
+		const KeySummary& ks = summary.keys[source];
+		KeyState& keys = state.keys[source];
+		for (UINT k = 0; k < ANALYSIS_KEYS; k++)
+		{
+			switch (ks.keyEffect[k])
+			{
+			case KEY_UP:
+				keys.isDown[k] = false;
+				break;
+			case KEY_DOWN_IF_UP:
+				if (keys.isDown[k]) break;
+				// Fall through
+			case KEY_DOWN:
+				keys.isDown[k] = true;
+				keys.downTime[k] = ks.keyTime[k];
+				break;
+			}
+		}
+
+		UINT first = ks.cPresses > MAX_PATTERN_LEN ? ks.cPresses - MAX_PATTERN_LEN : 0;
+		for (UINT i = first; i < ks.cPresses; i++)
+		{
+			Press press = ks.press[i & (MAX_PATTERN_LEN - 1)];
+			press.modifiers = (BYTE)((keys.modifiers & ~press.touched) | press.modifiers);
+			press.touched = 0;
+			keys.press[keys.cPresses++ & (MAX_PATTERN_LEN - 1)] = press;
+		}
+		keys.modifiers = (keys.modifiers & ~(ks.modifierSet | ks.modifierClear)) | ks.modifierSet;
+	}
+
+	for (UINT source = 0; source < MAX_SOURCES; source++)
+	{
+		if (!summary.hasMove[source]) continue;
+		state.hasMove[source] = true;
+		state.moveTime[source] = summary.moveTime[source];
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Bring a pattern detector to the key state of its source
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void CaptureAnalysis::Resume(const KeyState& keys, PatternDetector* pDetector)
+{
+	KeySymbol symbol[MAX_PATTERN_LEN];
+	ULONGLONG time[MAX_PATTERN_LEN];
+	UINT cSymbols = keys.cPresses < MAX_PATTERN_LEN ? keys.cPresses : MAX_PATTERN_LEN;
+	for (UINT i = 0; i < cSymbols; i++)
+	{
+		const Press& press = keys.press[(keys.cPresses - cSymbols + i) & (MAX_PATTERN_LEN - 1)];
+		symbol[i] = MAKEKEYSYMBOL(KeyScanCode(press.key), press.modifiers);
+		time[i] = press.timestamp;
+	}
+	pDetector->Resume(symbol, time, cSymbols, keys.modifiers);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Second pass - The statistics of a chunk, given the state at its start, which it leaves at
+// the end of the chunk. The detectors of the thread, by source, are grown as sources appear.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void CaptureAnalysis::Accumulate(const Chunk& chunk, State* pState, std::vector<PatternDetector>* pDetectors,
+	CaptureAggregate* pResult) const
+{
+	State& state = *pState;
+	CaptureAggregate& result = *pResult;
+
+	// Bring the pattern detector of each source to where it was at the start of the chunk
+	if (pDetectors)
+	{
+		if (pDetectors->size() < state.keys.size()) pDetectors->resize(state.keys.size(), *_pDetector);
+		for (size_t source = 0; source < pDetectors->size(); source++)
+		{
+			if (source < state.keys.size()) Resume(state.keys[source], &(*pDetectors)[source]);
+			else                            (*pDetectors)[source].Reset();
+		}
+	}
+
+	for (UINT i = 0; i < chunk.cRecords; i++)
+	{
+		const CaptureRecord& cr = chunk.pRecords[i];
+		int slot = MessageSlot(cr.message);
+		result.messages[slot < 0 ? MESSAGE_SLOTS : slot]++;
+
+		BOOL isKey = false;
+		switch (cr.message)
+		{
+		case WM_KEYDOWN:
+		case WM_SYSKEYDOWN:
+		{
+			WORD k = KeyIndex((LPARAM)cr.lParam);
+			BOOL isRepeat = HIWORD(cr.lParam) & KF_REPEAT;
+			if (isRepeat) result.key[k].repeats++;
+			else          result.key[k].downs++;
+			if (cr.source >= MAX_SOURCES) break;
+			if (state.keys.size() <= cr.source) state.keys.resize(cr.source + 1);
+			KeyState& keys = state.keys[cr.source];
+			isKey = true;
+
+			if (!keys.isDown[k])
+			{
+				keys.isDown[k] = true;
+				keys.downTime[k] = cr.timestamp;
+			}
+
+			UINT modifier = PatternDetector::ModifierOf((WPARAM)cr.wParam);
+			if (modifier) keys.modifiers |= modifier;
+			else if (!isRepeat)
+			{
+				if (keys.cPresses)
+				{
+					ULONGLONG last = keys.press[(keys.cPresses - 1) & (MAX_PATTERN_LEN - 1)].timestamp;
+					if (cr.timestamp >= last) result.press.Add(cr.timestamp - last);
+				}
+				Press& press = keys.press[keys.cPresses++ & (MAX_PATTERN_LEN - 1)];
+				press.key = k;
+				press.touched = 0;
+				press.modifiers = (BYTE)keys.modifiers;
+				press.timestamp = cr.timestamp;
+			}
+		}
+		break;
+
+		case WM_KEYUP:
+		case WM_SYSKEYUP:
+		{
+			WORD k = KeyIndex((LPARAM)cr.lParam);
+			KeyStats& ks = result.key[k];
+			ks.ups++;
+			if (cr.source >= MAX_SOURCES)
+			{
+				result.unmatchedUps++;
+				break;
+			}
+			if (state.keys.size() <= cr.source) state.keys.resize(cr.source + 1);
+			KeyState& keys = state.keys[cr.source];
+			isKey = true;
+
+			if (keys.isDown[k] && cr.timestamp >= keys.downTime[k])
+			{
+				ULONGLONG hold = cr.timestamp - keys.downTime[k];
+				ks.holds++;
+				ks.holdSum += hold;
+				if (hold > ks.holdMax) ks.holdMax = hold;
+				result.hold.Add(hold);
+			}
+			else result.unmatchedUps++;
+			keys.isDown[k] = false;
+			keys.modifiers &= ~PatternDetector::ModifierOf((WPARAM)cr.wParam);
+		}
+		break;
+
+		case WM_CHAR:
+		case WM_DEADCHAR:
+		case WM_SYSCHAR:
+		case WM_SYSDEADCHAR:
+			result.key[KeyIndex((LPARAM)cr.lParam)].chars++;
+			break;
+
+		case WM_MOUSEMOVE:
+			if (cr.source < MAX_SOURCES)
+			{
+				if (state.hasMove[cr.source] && cr.timestamp >= state.moveTime[cr.source])
+				{
+					result.move.Add(cr.timestamp - state.moveTime[cr.source]);
+				}
+				state.hasMove[cr.source] = true;
+				state.moveTime[cr.source] = cr.timestamp;
+			}
+			break;
+		}
+
+		if (pDetectors && isKey)
+		{
+			if (pDetectors->size() <= cr.source) pDetectors->resize(cr.source + 1, *_pDetector);
+			EventRecord er;
+			FromCaptureRecord(cr, &er);
+			PatternMatch match[MAX_CHUNK_MATCHES];
+			UINT cMatches = (*pDetectors)[cr.source].OnEvent(er, match, MAX_CHUNK_MATCHES);
+			for (UINT m = 0; m < cMatches; m++)
+			{
+				PatternHits& hits = result.hits[match[m].rule];
+				hits.count++;
+				if (chunk.position + i < hits.firstEvent) hits.firstEvent = chunk.position + i;
+			}
+		}
+	}
+	result.events += chunk.cRecords;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Analyze all files on the threads of the pool
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void CaptureAnalysis::Run(WorkStealingPool* pPool, CaptureAggregate* pResult)
+{
+	UINT cRules = _pDetector ? _pDetector->Rules() : 0;
+
+	std::vector<Chunk> chunks;
+	ULONGLONG position = 0;
+	for (const std::unique_ptr<CaptureFile>& pFile : _files)
+	{
+		for (ULONGLONG first = 0; first < pFile->Count(); first += _chunkEvents)
+		{
+			ULONGLONG cRecords = pFile->Count() - first;
+			Chunk chunk;
+			chunk.pRecords = pFile->Records() + first;
+			chunk.cRecords = (UINT)(cRecords < _chunkEvents ? cRecords : _chunkEvents);
+			chunk.position = position + first;
+			chunk.isFirst = first == 0;
+			chunks.push_back(chunk);
+		}
+		position += pFile->Count();
+	}
+
+	// First pass, then chain the summaries - Each file starts from nothing pressed
+	std::vector<Summary> summaries(chunks.size());
+	pPool->Run((UINT)chunks.size(), [&](UINT, UINT item) { Summarize(chunks[item], &summaries[item]); });
+
+	std::vector<State> starts(chunks.size());
+	for (size_t c = 0; c < chunks.size(); c++)
+	{
+		if (chunks[c].isFirst) starts[c] = State();
+		else
+		{
+			starts[c] = starts[c - 1];
+			Apply(summaries[c - 1], &starts[c]);
+		}
+	}
+	summaries.clear();
+
+	// Second pass into one partial result per thread, merged in thread order
+	UINT cThreads = pPool->Threads();
+	std::vector<CaptureAggregate> partial(cThreads);
+	std::vector<std::vector<PatternDetector>> detectors(cThreads);
+	for (UINT t = 0; t < cThreads; t++) partial[t].Reset(cRules);
+	pPool->Run((UINT)chunks.size(), [&](UINT worker, UINT item)
+		{
+			Accumulate(chunks[item], &starts[item], _pDetector ? &detectors[worker] : NULL, &partial[worker]);
+		});
+
+	pResult->Reset(cRules);
+	for (UINT t = 0; t < cThreads; t++) pResult->Merge(partial[t]);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The trajectory of the moves of each source over all files, one source per work item
+// The moves are gathered into structure-of-arrays buffers in one pass over the files, then
+// the batch kernel analyzes each source. A source is analyzed up to its first 4G moves.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void CaptureAnalysis::Trajectories(WorkStealingPool* pPool, std::vector<SourceTrajectory>* pResult) const
+{
+	struct Moves
+	{
+		std::vector<float>     x;
+		std::vector<float>     y;
+		std::vector<ULONGLONG> t;
+	};
+	std::vector<Moves> moves(MAX_SOURCES);
+	for (const std::unique_ptr<CaptureFile>& pFile : _files)
+	{
+		const CaptureRecord* pRecords = pFile->Records();
+		for (ULONGLONG i = 0; i < pFile->Count(); i++)
+		{
+			const CaptureRecord& cr = pRecords[i];
+			if (cr.message != WM_MOUSEMOVE || cr.source >= MAX_SOURCES) continue;
+
+			Moves& m = moves[cr.source];
+			if (m.t.size() == UINT_MAX) continue;
+			m.x.push_back((float)GET_X_LPARAM((LPARAM)cr.lParam));
+			m.y.push_back((float)GET_Y_LPARAM((LPARAM)cr.lParam));
+			m.t.push_back(cr.timestamp);
+		}
+	}
+
+	std::vector<UINT> sources;
+	for (UINT source = 0; source < MAX_SOURCES; source++)
+	{
+		if (moves[source].t.size() >= 2) sources.push_back(source);
+	}
+	pResult->assign(sources.size(), SourceTrajectory());
+	pPool->Run((UINT)sources.size(), [&](UINT, UINT item)
+		{
+			const Moves& m = moves[sources[item]];
+			std::vector<float> scratch(m.t.size());
+			SourceTrajectory& trajectory = (*pResult)[item];
+			trajectory.source = sources[item];
+			AnalyzeTrajectory(m.x.data(), m.y.data(), m.t.data(), (UINT)m.t.size(), scratch.data(), &trajectory.stats);
+		});
+}
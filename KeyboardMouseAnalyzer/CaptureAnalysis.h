@@ -0,0 +1,168 @@
+#pragma once
+#include "framework.h"
+#include "CaptureFile.h"
+#include "EventMerger.h"
+#include "MessageFormat.h"
+#include "PatternDetector.h"
+#include "Trajectory.h"
+#include "WorkStealingPool.h"
+
+#include <memory>
+#include <vector>
+
+#define ANALYSIS_KEYS (1 << SCANCODE_BITS)     // Extended scan codes, 0xE0 prefix folded into bit 8
+#define LATENCY_BUCKETS 256
+#define DEFAULT_CHUNK_EVENTS (256 * 1024)
+
+// A log-linear histogram of microseconds: four buckets per power of two, exact below 8
+class LatencyHistogram
+{
+private:
+	ULONGLONG _count[LATENCY_BUCKETS];
+public:
+	LatencyHistogram() { Reset(); }
+	void Reset() { ZeroMemory(_count, sizeof(_count)); }
+	void Add(ULONGLONG value) { _count[Bucket(value)]++; }
+	void Merge(const LatencyHistogram& other);
+	ULONGLONG Total() const;
+	ULONGLONG Percentile(UINT permille) const;
+	BOOL operator==(const LatencyHistogram& other) const;
+
+	static UINT Bucket(ULONGLONG value);
+	static ULONGLONG BucketLow(UINT bucket);
+};
+
+struct KeyStats
+{
+	ULONGLONG downs;        // Presses, not counting autorepeat
+	ULONGLONG repeats;
+	ULONGLONG ups;
+	ULONGLONG chars;        // WM_CHAR, WM_SYSCHAR and dead characters produced by the key
+	ULONGLONG holds;        // Ups that ended a known press
+	ULONGLONG holdSum;      // Microseconds
+	ULONGLONG holdMax;
+};
+
+struct PatternHits
+{
+	ULONGLONG count;
+	ULONGLONG firstEvent;   // Position of the earliest hit over all input, (ULONGLONG)-1 for none
+};
+
+// The result of an analysis, also the partial result of one thread.
+//
+// Everything is a count, a sum, a maximum or a minimum, so partial results merge to the
+// same totals in any order and the result does not depend on the number of threads.
+struct CaptureAggregate
+{
+	ULONGLONG                events;
+	ULONGLONG                messages[MESSAGE_SLOTS + 1];      // By MessageSlot(), then all others
+	ULONGLONG                unmatchedUps;                      // Key ups without a known press
+	KeyStats                 key[ANALYSIS_KEYS];
+	LatencyHistogram         hold;                              // Key down to key up
+	LatencyHistogram         press;                             // Between key presses
+	LatencyHistogram         move;                              // Between mouse moves of a source
+	std::vector<PatternHits> hits;                              // By rule
+
+	void Reset(UINT cRules);
+	void Merge(const CaptureAggregate& other);
+	BOOL operator==(const CaptureAggregate& other) const;
+};
+
+// The mouse trajectory of one capture source over all input
+struct SourceTrajectory
+{
+	UINT            source;
+	TrajectoryStats stats;
+};
+
+// Analyzes capture files on many threads.
+//
+// The files are cut into chunks of records. A chunk's statistics depend on what was before it:
+// keys still held, modifiers, the last presses for pattern matching and the last mouse moves.
+// So the analysis makes two parallel passes. The first summarizes how each chunk changes that
+// state, a short sequential pass chains the summaries into the exact state at the start of
+// every chunk, and the second computes the statistics of each chunk from its start state.
+// The result is exactly that of reading the files from start to end on one thread.
+//
+// Each capture source is a keyboard of its own: with raw input on, a key press is recorded
+// by the main window and by the raw input source of its device. So held keys, modifiers,
+// press intervals and pattern matching are kept per source, with one pattern detector per
+// source on each thread. The per key counts are over all sources.
+class CaptureAnalysis
+{
+private:
+	struct Press
+	{
+		WORD      key;              // Key index, see KeyIndex()
+		BYTE      touched;          // MOD_ flags changed in the chunk before the press
+		BYTE      modifiers;        // Their values, or all MOD_ flags once the start state is known
+		ULONGLONG timestamp;
+	};
+
+	// Key state of one capture source carried from one record to the next
+	struct KeyState
+	{
+		BYTE      isDown[ANALYSIS_KEYS];
+		ULONGLONG downTime[ANALYSIS_KEYS];
+		UINT      modifiers;
+		Press     press[MAX_PATTERN_LEN];       // Ring of the last presses
+		UINT      cPresses;
+	};
+
+	// State carried from one record to the next
+	struct State
+	{
+		std::vector<KeyState> keys;             // By source, up to the last source that sent keys
+		BYTE                  hasMove[MAX_SOURCES];
+		ULONGLONG             moveTime[MAX_SOURCES];
+	};
+
+	// How a chunk changes the key state of one capture source
+	struct KeySummary
+	{
+		BYTE      keyEffect[ANALYSIS_KEYS];
+		ULONGLONG keyTime[ANALYSIS_KEYS];
+		UINT      modifierSet;
+		UINT      modifierClear;
+		Press     press[MAX_PATTERN_LEN];
+		UINT      cPresses;
+	};
+
+	// How a chunk changes the state, whatever it was at the start of the chunk
+	struct Summary
+	{
+		std::vector<KeySummary> keys;           // By source, up to the last source that sent keys
+		BYTE                    hasMove[MAX_SOURCES];
+		ULONGLONG               moveTime[MAX_SOURCES];
+	};
+
+	struct Chunk
+	{
+		const CaptureRecord* pRecords;
+		UINT                 cRecords;
+		ULONGLONG            position;          // Of the first record over all input
+		BOOL                 isFirst;           // First chunk of its file
+	};
+
+	std::vector<std::unique_ptr<CaptureFile>> _files;
+	const PatternDetector*                    _pDetector;
+	UINT                                      _chunkEvents;
+	ULONGLONG                                 _events;
+
+	void Summarize(const Chunk& chunk, Summary* pSummary) const;
+	static void Apply(const Summary& summary, State* pState);
+	static void Resume(const KeyState& keys, PatternDetector* pDetector);
+	void Accumulate(const Chunk& chunk, State* pState, std::vector<PatternDetector>* pDetectors, CaptureAggregate* pResult) const;
+public:
+	CaptureAnalysis();
+	BOOL AddFile(const TCHAR* pszPath);
+	void SetRules(const PatternDetector* pDetector) { _pDetector = pDetector; }
+	void SetChunkEvents(UINT chunkEvents) { _chunkEvents = chunkEvents ? chunkEvents : DEFAULT_CHUNK_EVENTS; }
+	void Run(WorkStealingPool* pPool, CaptureAggregate* pResult);
+	void Trajectories(WorkStealingPool* pPool, std::vector<SourceTrajectory>* pResult) const;
+	ULONGLONG Events() const { return _events; }
+
+	static WORD KeyIndex(LPARAM lParam);
+	static WORD KeyScanCode(WORD key);
+};
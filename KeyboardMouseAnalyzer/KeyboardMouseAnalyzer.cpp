@@ -0,0 +1,317 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// KeyboardMouseAnalyzer.cpp : Defines the entry point for the console application.
+//
+// Offline reports over capture files saved by KeyboardMouseMonitor: per key statistics,
+// latency distributions, pattern hits and mouse trajectories, computed on all cores.
+//
+// KeyboardMouseAnalyzer [-t threads] [-c chunkEvents] [-r rulesFile] capture.kmc ...
+//     Analyze the files as one session per file and print the report.
+// KeyboardMouseAnalyzer --bench [-c chunkEvents] [-r rulesFile] capture.kmc ...
+//     Analyze on 1, 2, 4 ... threads up to the number of cores and print the scaling as CSV.
+// KeyboardMouseAnalyzer --generate count [-s seed] capture.kmc
+//     Write a capture file of synthetic input from the load generator.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "CaptureAnalysis.h"
+#include "KeyNames.h"
+#include "LoadGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#define MAX_REPORT_KEYS 20
+#define BENCH_RUNS 3                    // Best of, per thread count
+
+
+
+//
+//  FUNCTION: Seconds()
+//
+//  PURPOSE: Time since an arbitrary start, for measuring runs.
+//
+static double Seconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+
+//
+//  FUNCTION: Generate(const TCHAR*, ULONGLONG, ULONGLONG)
+//
+//  PURPOSE: Writes a capture file of synthetic input.
+//
+//  COMMENTS:
+//
+//        The gestures of the mixed load profile, one source, with 100 us to 2 ms between
+//        records so that hold times and intervals have realistic spread.
+//
+static int Generate(const TCHAR* pszPath, ULONGLONG count, ULONGLONG seed)
+{
+	LoadConfig config;
+	LoadConfigProfile(&config, LOAD_PROFILE_MIXED);
+	config.seed = seed;
+
+	CaptureWriter writer;
+	if (!writer.Open(pszPath))
+	{
+		_ftprintf(stderr, _T("Cannot create %s\n"), pszPath);
+		return 1;
+	}
+
+	ULONGLONG random = seed ? seed : 1;
+	ULONGLONG timestamp = 0;
+	EventRecord gesture[MAX_GESTURE_LEN];
+	for (ULONGLONG n = 0; n < count;)
+	{
+		UINT cGesture = LoadGenerator::Gesture(config, random, 0, gesture);
+		for (UINT i = 0; i < cGesture && n < count; i++, n++)
+		{
+			random ^= random << 13;
+			random ^= random >> 7;
+			random ^= random << 17;
+			timestamp += 100 + random % 1900;
+			gesture[i].sequence = (UINT)n + 1;
+			gesture[i].timestamp = timestamp;
+			writer.Write(gesture[i]);
+		}
+	}
+	if (!writer.Close())
+	{
+		_ftprintf(stderr, _T("Cannot write %s\n"), pszPath);
+		return 1;
+	}
+	_tprintf(_T("%llu records written to %s\n"), count, pszPath);
+	return 0;
+}
+
+
+
+//
+//  FUNCTION: PrintLatency(const TCHAR*, const LatencyHistogram&)
+//
+//  PURPOSE: Prints one line of the latency table.
+//
+static void PrintLatency(const TCHAR* pszName, const LatencyHistogram& histogram)
+{
+	_tprintf(_T("  %-18s %12llu %10llu %10llu %10llu\n"), pszName, histogram.Total(),
+		histogram.Percentile(500), histogram.Percentile(900), histogram.Percentile(990));
+}
+
+
+
+//
+//  FUNCTION: Report(const CaptureAggregate&, const PatternDetector&)
+//
+//  PURPOSE: Prints the result of an analysis.
+//
+static void Report(const CaptureAggregate& result, const PatternDetector& detector)
+{
+	_tprintf(_T("\nMessages\n"));
+	for (UINT slot = 0; slot < MESSAGE_SLOTS; slot++)
+	{
+		if (result.messages[slot] == 0) continue;
+		_tprintf(_T("  %-18s %12llu\n"), messageTable[slot].pszName, result.messages[slot]);
+	}
+	if (result.messages[MESSAGE_SLOTS]) _tprintf(_T("  %-18s %12llu\n"), _T("Other"), result.messages[MESSAGE_SLOTS]);
+
+	// Keys with the most presses, ties by key
+	std::vector<WORD> keys;
+	for (WORD k = 0; k < ANALYSIS_KEYS; k++)
+	{
+		if (result.key[k].downs || result.key[k].repeats || result.key[k].ups || result.key[k].chars) keys.push_back(k);
+	}
+	std::stable_sort(keys.begin(), keys.end(),
+		[&](WORD a, WORD b) { return result.key[a].downs > result.key[b].downs; });
+	if (keys.size() > MAX_REPORT_KEYS) keys.resize(MAX_REPORT_KEYS);
+
+	_tprintf(_T("\nKeys                         Presses    Repeats        Ups      Chars   Hold avg   Hold max (us)\n"));
+	for (WORD k : keys)
+	{
+		const KeyStats& ks = result.key[k];
+		WORD scanCode = CaptureAnalysis::KeyScanCode(k);
+		_tprintf(_T("  0x%04X %-14s %12llu %10llu %10llu %10llu %10llu %10llu\n"), scanCode, ScanCodeName(scanCode).pszName,
+			ks.downs, ks.repeats, ks.ups, ks.chars, ks.holds ? ks.holdSum / ks.holds : 0, ks.holdMax);
+	}
+	if (result.unmatchedUps) _tprintf(_T("  Key ups without a press: %llu\n"), result.unmatchedUps);
+
+	_tprintf(_T("\nLatency (us)              Count        p50        p90        p99\n"));
+	PrintLatency(_T("Hold"), result.hold);
+	PrintLatency(_T("Between presses"), result.press);
+	PrintLatency(_T("Between moves"), result.move);
+
+	if (detector.Rules())
+	{
+		_tprintf(_T("\nPatterns                    Hits      First\n"));
+		for (UINT r = 0; r < detector.Rules(); r++)
+		{
+			const PatternHits& hits = result.hits[r];
+			if (hits.count) _tprintf(_T("  %-20s %10llu %10llu\n"), detector.RuleText(r), hits.count, hits.firstEvent);
+			else            _tprintf(_T("  %-20s %10llu %10s\n"), detector.RuleText(r), hits.count, _T("-"));
+		}
+	}
+}
+
+
+
+//
+//  FUNCTION: ReportTrajectories(const std::vector<SourceTrajectory>&)
+//
+//  PURPOSE: Prints the mouse trajectory of each capture source.
+//
+static void ReportTrajectories(const std::vector<SourceTrajectory>& trajectories)
+{
+	if (trajectories.empty()) return;
+
+	_tprintf(_T("\nTrajectories               Moves    Rate Hz  Jitter us Speed px/s       Peak  Accel px/s2       Peak  Path px\n"));
+	for (const SourceTrajectory& trajectory : trajectories)
+	{
+		const TrajectoryStats& ts = trajectory.stats;
+		_tprintf(_T("  Source %-10u %12u %10.0f %10.0f %10.0f %10.0f %12.0f %10.0f %8.2f\n"), trajectory.source,
+			ts.cSamples, ts.pollingRate, ts.intervalJitter * 1e6f, ts.meanSpeed, ts.peakSpeed,
+			ts.meanAcceleration, ts.peakAcceleration, ts.pathJitter);
+	}
+}
+
+
+
+//
+//  FUNCTION: Bench(CaptureAnalysis&)
+//
+//  PURPOSE: Prints the scaling of the analysis with the number of threads, as CSV.
+//
+//  COMMENTS:
+//
+//        Every run is checked against the single thread result, so the curve also shows
+//        that the result does not depend on the number of threads.
+//
+static int Bench(CaptureAnalysis& analysis)
+{
+	UINT cCores = std::thread::hardware_concurrency();
+	if (cCores == 0) cCores = 1;
+
+	std::vector<UINT> threadCounts;
+	for (UINT t = 1; t < cCores; t *= 2) threadCounts.push_back(t);
+	threadCounts.push_back(cCores);
+
+	_tprintf(_T("threads,seconds,events_per_second,speedup,efficiency,steals,identical\n"));
+	CaptureAggregate reference;
+	double baseline = 0;
+	BOOL bAllIdentical = true;
+	for (UINT cThreads : threadCounts)
+	{
+		WorkStealingPool pool(cThreads);
+		CaptureAggregate result;
+		double best = 0;
+		for (UINT run = 0; run < BENCH_RUNS; run++)
+		{
+			double start = Seconds();
+			analysis.Run(&pool, &result);
+			double seconds = Seconds() - start;
+			if (run == 0 || seconds < best) best = seconds;
+		}
+		if (cThreads == 1)
+		{
+			reference = result;
+			baseline = best;
+		}
+		BOOL bIdentical = result == reference;
+		if (!bIdentical) bAllIdentical = false;
+		_tprintf(_T("%u,%.6f,%.0f,%.3f,%.3f,%llu,%s\n"), cThreads, best, analysis.Events() / best,
+			baseline / best, baseline / best / cThreads, pool.Steals(), bIdentical ? _T("yes") : _T("no"));
+	}
+	return bAllIdentical ? 0 : 2;
+}
+
+
+
+//
+//  FUNCTION: Usage()
+//
+//  PURPOSE: Prints the command line.
+//
+static int Usage()
+{
+	_ftprintf(stderr,
+		_T("Usage: KeyboardMouseAnalyzer [-t threads] [-c chunkEvents] [-r rulesFile] capture.kmc ...\n")
+		_T("       KeyboardMouseAnalyzer --bench [-c chunkEvents] [-r rulesFile] capture.kmc ...\n")
+		_T("       KeyboardMouseAnalyzer --generate count [-s seed] capture.kmc\n"));
+	return 1;
+}
+
+
+
+//
+//  FUNCTION: _tmain(int, TCHAR*[])
+//
+//  PURPOSE: Parses the command line and runs the analysis.
+//
+int _tmain(int argc, TCHAR* argv[])
+{
+	UINT cThreads = std::thread::hardware_concurrency();
+	UINT chunkEvents = DEFAULT_CHUNK_EVENTS;
+	ULONGLONG generate = 0;
+	ULONGLONG seed = 1;
+	BOOL bBench = false;
+	PatternDetector detector;
+	std::vector<const TCHAR*> files;
+
+	for (int i = 1; i < argc; i++)
+	{
+		BOOL hasValue = i + 1 < argc;
+		if      (!_tcscmp(argv[i], _T("-t")) && hasValue) cThreads = _tcstoul(argv[++i], NULL, 10);
+		else if (!_tcscmp(argv[i], _T("-c")) && hasValue) chunkEvents = _tcstoul(argv[++i], NULL, 10);
+		else if (!_tcscmp(argv[i], _T("-s")) && hasValue) seed = _tcstoui64(argv[++i], NULL, 10);
+		else if (!_tcscmp(argv[i], _T("--generate")) && hasValue) generate = _tcstoui64(argv[++i], NULL, 10);
+		else if (!_tcscmp(argv[i], _T("--bench"))) bBench = true;
+		else if (!_tcscmp(argv[i], _T("-r")) && hasValue)
+		{
+			if (detector.LoadRules(argv[++i]) == 0)
+			{
+				_ftprintf(stderr, _T("No rules loaded from %s\n"), argv[i]);
+				return 1;
+			}
+		}
+		else if (argv[i][0] == _T('-')) return Usage();
+		else files.push_back(argv[i]);
+	}
+	if (files.empty()) return Usage();
+
+	if (generate)
+	{
+		if (files.size() != 1) return Usage();
+		return Generate(files[0], generate, seed);
+	}
+
+	detector.Compile();
+	CaptureAnalysis analysis;
+	analysis.SetRules(&detector);
+	analysis.SetChunkEvents(chunkEvents);
+	for (const TCHAR* pszPath : files)
+	{
+		if (!analysis.AddFile(pszPath))
+		{
+			_ftprintf(stderr, _T("%s is not a capture file\n"), pszPath);
+			return 1;
+		}
+	}
+
+	if (bBench) return Bench(analysis);
+
+	WorkStealingPool pool(cThreads);
+	CaptureAggregate result;
+	double start = Seconds();
+	analysis.Run(&pool, &result);
+	double seconds = Seconds() - start;
+
+	_tprintf(_T("%llu events in %u files, %u threads, %.3f s, %.0f events/s\n"),
+		result.events, (UINT)files.size(), pool.Threads(), seconds, seconds > 0 ? result.events / seconds : 0);
+	Report(result, detector);
+
+	std::vector<SourceTrajectory> trajectories;
+	analysis.Trajectories(&pool, &trajectories);
+	ReportTrajectories(trajectories);
+	return 0;
+}
@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// WorkStealingPool.cpp : Provides a thread pool that balances numbered work items by stealing.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "WorkStealingPool.h"
+
+#include <thread>
+
+#define MAKERANGE(next, end) (((ULONGLONG)(next) << 32) | (end))
+#define RANGENEXT(range) ((UINT)((range) >> 32))
+#define RANGEEND(range) ((UINT)(range))
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor - Worker 0 is the thread that calls Run()
+///////////////////////////////////////////////////////////////////////////////////////////////////
+WorkStealingPool::WorkStealingPool(UINT cThreads) : _worker(cThreads < 1 ? 1 : cThreads > MAX_POOL_THREADS ? MAX_POOL_THREADS : cThreads)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Run work(worker, item) for items 0 .. cItems - 1 and return when all are done
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void WorkStealingPool::Run(UINT cItems, const std::function<void(UINT worker, UINT item)>& work)
+{
+	UINT cWorkers = (UINT)_worker.size();
+	for (UINT w = 0; w < cWorkers; w++)
+	{
+		UINT begin = (UINT)((ULONGLONG)cItems * w / cWorkers);
+		UINT end = (UINT)((ULONGLONG)cItems * (w + 1) / cWorkers);
+		_worker[w].range.store(MAKERANGE(begin, end), std::memory_order_relaxed);
+		_worker[w].executed = 0;
+		_worker[w].steals = 0;
+	}
+
+	std::vector<std::thread> threads;
+	for (UINT w = 1; w < cWorkers; w++) threads.emplace_back(&WorkStealingPool::Work, this, w, std::cref(work));
+	Work(0, work);
+	for (std::thread& thread : threads) thread.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Take items until no worker has any left
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void WorkStealingPool::Work(UINT self, const std::function<void(UINT worker, UINT item)>& work)
+{
+	UINT item;
+	while (Take(self, &item) || Steal(self, &item))
+	{
+		work(self, item);
+		_worker[self].executed++;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Take the next item of the worker's own range
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL WorkStealingPool::Take(UINT self, UINT* pItem)
+{
+	std::atomic<ULONGLONG>& range = _worker[self].range;
+	ULONGLONG current = range.load(std::memory_order_acquire);
+	while (RANGENEXT(current) < RANGEEND(current))
+	{
+		if (range.compare_exchange_weak(current, MAKERANGE(RANGENEXT(current) + 1, RANGEEND(current)),
+			std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			*pItem = RANGENEXT(current);
+			return true;
+		}
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Take the back half of another worker's range - Returns false when every range is empty
+//
+// The stolen range is stored as the thief's own only after it is taken from the victim, and a
+// thief's range is empty until then, so no item can be taken twice. A worker that finds every
+// range empty while a thief holds stolen items only stops early; the thief does the items.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL WorkStealingPool::Steal(UINT self, UINT* pItem)
+{
+	UINT cWorkers = (UINT)_worker.size();
+	for (UINT i = 1; i < cWorkers; i++)
+	{
+		std::atomic<ULONGLONG>& range = _worker[(self + i) % cWorkers].range;
+		ULONGLONG current = range.load(std::memory_order_acquire);
+		while (RANGENEXT(current) < RANGEEND(current))
+		{
+			UINT next = RANGENEXT(current), end = RANGEEND(current);
+			UINT middle = next + (end - next) / 2;
+			if (range.compare_exchange_weak(current, MAKERANGE(next, middle),
+				std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				_worker[self].range.store(MAKERANGE(middle + 1, end), std::memory_order_release);
+				_worker[self].steals++;
+				*pItem = middle;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The number of steals of the last Run()
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ULONGLONG WorkStealingPool::Steals() const
+{
+	ULONGLONG steals = 0;
+	for (const Worker& worker : _worker) steals += worker.steals;
+	return steals;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "framework.h"
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#define MAX_POOL_THREADS 256
+
+// Runs numbered work items on a fixed set of threads.
+//
+// Every worker starts with an even share of the items as a range it takes from the front.
+// A worker whose range runs out steals the back half of another worker's range, so the
+// threads stay busy when items take unequal time. A range is one 64 bit word changed with
+// compare-and-swap, which makes taking an item lock free.
+class WorkStealingPool
+{
+private:
+	struct alignas(64) Worker
+	{
+		std::atomic<ULONGLONG> range;           // Next item in the high half, end in the low half
+		ULONGLONG              executed;
+		ULONGLONG              steals;
+	};
+
+	std::vector<Worker> _worker;
+
+	BOOL Take(UINT self, UINT* pItem);
+	BOOL Steal(UINT self, UINT* pItem);
+	void Work(UINT self, const std::function<void(UINT worker, UINT item)>& work);
+public:
+	WorkStealingPool(UINT cThreads);
+	void Run(UINT cItems, const std::function<void(UINT worker, UINT item)>& work);
+
+	UINT Threads() const { return (UINT)_worker.size(); }
+	ULONGLONG Executed(UINT worker) const { return _worker[worker].executed; }
+	ULONGLONG Steals() const;
+};
@@ -0,0 +1,259 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Benchmark.cpp : Provides the timing, allocation counting and reporting of the benchmarks.
+//
+//                 The global operator new and delete are replaced here to count allocations,
+//                 so this file must be linked into the benchmark program only.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "Benchmark.h"
+
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <new>
+
+#define MAX_JSON_LINE 512
+
+static std::atomic<ULONGLONG> cAllocations(0);
+static std::atomic<ULONGLONG> cbAllocated(0);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Counting replacements of the global operator new and delete
+///////////////////////////////////////////////////////////////////////////////////////////////////
+static void* Allocate(size_t cb)
+{
+	cAllocations.fetch_add(1, std::memory_order_relaxed);
+	cbAllocated.fetch_add(cb, std::memory_order_relaxed);
+	return malloc(cb ? cb : 1);
+}
+
+static void* AllocateAligned(size_t cb, std::align_val_t alignment)
+{
+	cAllocations.fetch_add(1, std::memory_order_relaxed);
+	cbAllocated.fetch_add(cb, std::memory_order_relaxed);
+#ifdef _WIN32
+	return _aligned_malloc(cb ? cb : 1, (size_t)alignment);
+#else
+	void* p = NULL;
+	return posix_memalign(&p, (size_t)alignment, cb ? cb : 1) == 0 ? p : NULL;
+#endif
+}
+
+static void FreeAligned(void* p)
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+void* operator new(size_t cb)
+{
+	void* p = Allocate(cb);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t cb)
+{
+	void* p = Allocate(cb);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t cb, const std::nothrow_t&) noexcept { return Allocate(cb); }
+void* operator new[](size_t cb, const std::nothrow_t&) noexcept { return Allocate(cb); }
+
+void* operator new(size_t cb, std::align_val_t alignment)
+{
+	void* p = AllocateAligned(cb, alignment);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t cb, std::align_val_t alignment)
+{
+	void* p = AllocateAligned(cb, alignment);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { FreeAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { FreeAligned(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { FreeAligned(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { FreeAligned(p); }
+
+ULONGLONG Benchmark::Allocations()
+{
+	return cAllocations.load(std::memory_order_relaxed);
+}
+
+ULONGLONG Benchmark::AllocatedBytes()
+{
+	return cbAllocated.load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+Benchmark::Benchmark()
+{
+	_pszFilter = NULL;
+	_minSeconds = BENCH_MIN_SECONDS;
+	_sink = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Whether a benchmark is run - Its name contains the filter, if there is one
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL Benchmark::Selected(const TCHAR* pszName) const
+{
+	return _pszFilter == NULL || _tcsstr(pszName, _pszFilter) != NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Whether any of a group of benchmarks is run - For the setup that the group shares
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL Benchmark::SelectedAny(std::initializer_list<const TCHAR*> names) const
+{
+	for (const TCHAR* pszName : names)
+	{
+		if (Selected(pszName)) return true;
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Time a benchmark - The setup, if any, is called before each run and is not timed
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void Benchmark::Run(const TCHAR* pszName, const TCHAR* pszUnit, const BenchBody& body,
+	const std::function<void()>& setup)
+{
+	if (!Selected(pszName)) return;
+
+	BenchResult result = {};
+	StringCchCopy(result.szName, MAX_BENCH_NAME, pszName);
+	result.pszUnit = pszUnit;
+
+	// Double the operations until a run is long enough, then keep the fastest of the runs
+	ULONGLONG cOps = 1024;
+	double best = 0;
+	for (UINT run = 0; run < BENCH_RUNS;)
+	{
+		if (setup) setup();
+		ULONGLONG allocationsBefore = Allocations();
+		ULONGLONG bytesBefore = AllocatedBytes();
+		auto start = std::chrono::steady_clock::now();
+		_sink += body(cOps);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		ULONGLONG allocations = Allocations() - allocationsBefore;
+		ULONGLONG bytes = AllocatedBytes() - bytesBefore;
+
+		if (run == 0 && seconds < _minSeconds)
+		{
+			cOps *= seconds > 0 && seconds * 8 < _minSeconds ? 8 : 2;
+			continue;
+		}
+		if (run == 0 || seconds < best)
+		{
+			best = seconds;
+			result.allocsPerOp = (double)allocations / cOps;
+			result.bytesPerOp = (double)bytes / cOps;
+		}
+		run++;
+	}
+	result.operations = cOps;
+	result.nsPerOp = best * 1e9 / cOps;
+	result.opsPerSecond = best > 0 ? cOps / best : 0;
+
+	const BenchResult* pBaseline = Baseline(result.szName);
+	if (pBaseline && pBaseline->nsPerOp > 0) result.baselineRatio = result.nsPerOp / pBaseline->nsPerOp;
+	_results.push_back(result);
+
+	_tprintf(_T("%-34s %12.1f ns/%-6s %14.0f /s %10.4f allocs %12.1f bytes"),
+		result.szName, result.nsPerOp, result.pszUnit, result.opsPerSecond, result.allocsPerOp, result.bytesPerOp);
+	if (result.baselineRatio > 0) _tprintf(_T("  x%.3f"), result.baselineRatio);
+	_tprintf(_T("\n"));
+	fflush(stdout);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Print the summary line - The results themselves are printed as they are measured
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void Benchmark::Print() const
+{
+	double product = 1;
+	UINT cCompared = 0;
+	for (const BenchResult& result : _results)
+	{
+		if (result.baselineRatio <= 0) continue;
+		product *= result.baselineRatio;
+		cCompared++;
+	}
+	_tprintf(_T("\n%u benchmarks"), (UINT)_results.size());
+	if (cCompared) _tprintf(_T(", %u compared, geometric mean time ratio %.3f"), cCompared, pow(product, 1.0 / cCompared));
+	_tprintf(_T("  (checksum %llu)\n"), _sink);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Write the results as JSON Lines - The names need no escaping
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL Benchmark::WriteJson(const TCHAR* pszPath) const
+{
+	FILE* pFile;
+	if (_tfopen_s(&pFile, pszPath, _T("w")) != 0) return false;
+	for (const BenchResult& result : _results)
+	{
+		_ftprintf(pFile, _T("{\"benchmark\":\"%s\",\"unit\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.3f,")
+			_T("\"ops_per_sec\":%.1f,\"allocs_per_op\":%.6f,\"bytes_per_op\":%.3f}\n"),
+			result.szName, result.pszUnit, result.operations, result.nsPerOp,
+			result.opsPerSecond, result.allocsPerOp, result.bytesPerOp);
+	}
+	return fclose(pFile) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Read the results of an earlier run, as written by WriteJson()
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL Benchmark::LoadBaseline(const TCHAR* pszPath)
+{
+	FILE* pFile;
+	if (_tfopen_s(&pFile, pszPath, _T("r")) != 0) return false;
+
+	TCHAR szLine[MAX_JSON_LINE];
+	while (_fgetts(szLine, MAX_JSON_LINE, pFile))
+	{
+		const TCHAR* pszName = _tcsstr(szLine, _T("\"benchmark\":\""));
+		const TCHAR* pszTime = _tcsstr(szLine, _T("\"ns_per_op\":"));
+		if (!pszName || !pszTime) continue;
+		pszName += 13;
+
+		BenchResult result = {};
+		UINT cch = 0;
+		while (pszName[cch] && pszName[cch] != _T('"') && cch < MAX_BENCH_NAME - 1)
+		{
+			result.szName[cch] = pszName[cch];
+			cch++;
+		}
+		result.szName[cch] = 0;
+		result.nsPerOp = _tcstod(pszTime + 12, NULL);
+		_baseline.push_back(result);
+	}
+	fclose(pFile);
+	return true;
+}
+
+const BenchResult* Benchmark::Baseline(const TCHAR* pszName) const
+{
+	for (const BenchResult& result : _baseline)
+	{
+		if (_tcscmp(result.szName, pszName) == 0) return &result;
+	}
+	return NULL;
+}
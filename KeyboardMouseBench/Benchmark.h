@@ -0,0 +1,64 @@
+#pragma once
+#include "framework.h"
+
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+#define MAX_BENCH_NAME 48
+#define BENCH_RUNS 3                        // Best of, per benchmark
+#define BENCH_MIN_SECONDS 0.25              // Shortest timed run, the operations are repeated to reach it
+
+// The measurement of one benchmark
+struct BenchResult
+{
+	TCHAR        szName[MAX_BENCH_NAME];
+	const TCHAR* pszUnit;                   // What one operation is, "event" for the pipeline stages
+	ULONGLONG    operations;                // Per timed run
+	double       nsPerOp;                   // Of the fastest run
+	double       opsPerSecond;
+	double       allocsPerOp;               // Calls to operator new, of the fastest run
+	double       bytesPerOp;
+	double       baselineRatio;             // nsPerOp over the baseline's, 0 when there is none
+};
+
+// A benchmark body performs the given number of operations and returns a value depending
+// on all of them, so that the compiler cannot leave any out.
+typedef std::function<ULONGLONG(ULONGLONG cOps)> BenchBody;
+
+// Times benchmarks and reports them.
+//
+// The number of operations per run is doubled until a run takes BENCH_MIN_SECONDS, then
+// the fastest of BENCH_RUNS runs is kept. Allocations are counted by replacing the global
+// operator new (see Benchmark.cpp), so they include everything the benchmark calls.
+// The results can be written as JSON Lines, one object per benchmark, and compared with
+// the results of an earlier build.
+class Benchmark
+{
+private:
+	std::vector<BenchResult> _results;
+	std::vector<BenchResult> _baseline;
+	const TCHAR*             _pszFilter;
+	double                   _minSeconds;
+	ULONGLONG                _sink;
+
+	const BenchResult* Baseline(const TCHAR* pszName) const;
+public:
+	Benchmark();
+	void SetFilter(const TCHAR* pszFilter) { _pszFilter = pszFilter; }
+	void SetMinSeconds(double seconds) { _minSeconds = seconds; }
+	BOOL LoadBaseline(const TCHAR* pszPath);
+
+	BOOL Selected(const TCHAR* pszName) const;
+	BOOL SelectedAny(std::initializer_list<const TCHAR*> names) const;
+	void Run(const TCHAR* pszName, const TCHAR* pszUnit, const BenchBody& body,
+		const std::function<void()>& setup = std::function<void()>());
+
+	void Print() const;
+	BOOL WriteJson(const TCHAR* pszPath) const;
+	const std::vector<BenchResult>& Results() const { return _results; }
+	ULONGLONG Sink() const { return _sink; }
+
+	static ULONGLONG Allocations();
+	static ULONGLONG AllocatedBytes();
+};
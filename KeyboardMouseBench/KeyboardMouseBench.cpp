@@ -0,0 +1,678 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// KeyboardMouseBench.cpp : Defines the entry point for the benchmark program.
+//
+// Times each stage that a message goes through in KeyboardMouseMonitor, and the whole
+// pipeline, over a corpus of synthetic input from the load generator. Each benchmark
+// reports the time and the allocations per operation; an operation is one message
+// unless the unit says otherwise.
+//
+// Beyond the stages, it covers the sizes the features are meant to scale to: pattern
+// matching with up to 10000 rules, the batch trajectory over 4M moves, the search of
+// 5M typed characters, and the key names with an A/B of the rows they are written to.
+//
+// KeyboardMouseBench [--filter text] [--min-time seconds] [--json results.json] [--compare baseline.json]
+//     --filter     Run only the benchmarks whose name contains the text.
+//     --min-time   Shortest timed run, 0.25 seconds by default.
+//     --json       Write the results as JSON Lines, one object per benchmark.
+//     --compare    Print the time of each benchmark as a ratio to that of an earlier --json.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "Benchmark.h"
+#include "ApplicationRegistry.h"
+#include "DisplayRows.h"
+#include "EventHistory.h"
+#include "EventMerger.h"
+#include "HeatMap.h"
+#include "KeyNames.h"
+#include "KeystrokeJoin.h"
+#include "LoadGenerator.h"
+#include "MessageFormat.h"
+#include "PatternDetector.h"
+#include "Trajectory.h"
+#include "TypedText.h"
+
+#include <windowsx.h>
+#include <memory>
+#include <vector>
+
+#define CORPUS_EVENTS 65536                 // Power of two, the corpus is repeated as needed
+#define CORPUS_SOURCES 4                    // Capture sources the gestures are spread over
+#define PIPELINE_BATCH 64                   // Messages pushed to the queues between merges
+#define MAX_ROW_LEN 175                     // As the rows are painted
+#define MAX_BENCH_MATCHES 8
+#define SETTINGS_BLOCK 44                   // The size of a WINDOWPLACEMENT
+#define TRAJECTORY_SAMPLES (4 * 1024 * 1024) // Moves in the batch trajectory, as in a long capture
+#define FIND_TEXT_CHARS (5 * 1024 * 1024) // Typed text searched, a long session of typing
+#define MIN_GENERATED_RULE 2                // Keys per generated rule
+#define MAX_GENERATED_RULE 6
+
+// Rules in the style of a rules file, so that the pattern stage does real work
+static const TCHAR* benchRules[] =
+{
+	_T("Ctrl+Shift+0x1E"),
+	_T("Alt+0x21 Alt+0x21"),
+	_T("0x1E 0x30 0x2E 200ms"),
+	_T("Ctrl+0x2E Ctrl+0x2F"),
+	_T("0xE048 0xE048 0xE050 0xE050 0xE04B 0xE04D 0xE04B 0xE04D 0x30 0x1E"),
+};
+
+// Rule counts of the generated rule sets, as a large rules file would have
+static const UINT generatedRuleCounts[] = { 1000, 3000, 10000 };
+
+
+
+//
+//  CLASS: Corpus
+//
+//  PURPOSE: The synthetic input that the benchmarks run over.
+//
+//  COMMENTS:
+//
+//        The gestures of the mixed load profile, spread over a few sources, with 100 us to
+//        2 ms between messages. Repeating the corpus moves its timestamps on, so that time
+//        never runs backwards however many messages a benchmark takes.
+//
+class Corpus
+{
+private:
+	std::vector<EventRecord> _events;
+	ULONGLONG                _span;
+public:
+	Corpus();
+	EventRecord At(ULONGLONG i) const
+	{
+		EventRecord er = _events[i & (CORPUS_EVENTS - 1)];
+		er.sequence = (UINT)i + 1;
+		er.timestamp += (i / CORPUS_EVENTS) * _span;
+		return er;
+	}
+	const EventRecord& Raw(ULONGLONG i) const { return _events[i & (CORPUS_EVENTS - 1)]; }
+};
+
+Corpus::Corpus()
+{
+	LoadConfig config;
+	LoadConfigProfile(&config, LOAD_PROFILE_MIXED);
+
+	ULONGLONG random = config.seed;
+	ULONGLONG timestamp = 0;
+	EventRecord gesture[MAX_GESTURE_LEN];
+	_events.reserve(CORPUS_EVENTS);
+	for (UINT source = 0; _events.size() < CORPUS_EVENTS; source = (source + 1) % CORPUS_SOURCES)
+	{
+		UINT cGesture = LoadGenerator::Gesture(config, random, source, gesture);
+		for (UINT i = 0; i < cGesture && _events.size() < CORPUS_EVENTS; i++)
+		{
+			random ^= random << 13;
+			random ^= random >> 7;
+			random ^= random << 17;
+			timestamp += 100 + random % 1900;
+			gesture[i].sequence = (UINT)_events.size() + 1;
+			gesture[i].timestamp = timestamp;
+			_events.push_back(gesture[i]);
+		}
+	}
+	_span = timestamp + 100;
+}
+
+
+
+//
+//  FUNCTION: AddRules(PatternDetector&)
+//
+//  PURPOSE: Compiles the benchmark rules.
+//
+static void AddRules(PatternDetector& detector)
+{
+	for (const TCHAR* pszRule : benchRules) detector.AddRule(pszRule);
+	detector.Compile();
+}
+
+
+
+//
+//  FUNCTION: GenerateRules(PatternDetector&, const Corpus&, UINT)
+//
+//  PURPOSE: Compiles the given number of generated rules.
+//
+//  COMMENTS:
+//
+//        Each rule is a run of MIN_GENERATED_RULE to MAX_GENERATED_RULE key presses taken
+//        from the corpus at random, with Ctrl+Shift+ for some of them, so that the rules
+//        share prefixes and keep matching as the corpus is replayed.
+//
+static void GenerateRules(PatternDetector& detector, const Corpus& corpus, UINT cRules)
+{
+	std::vector<WORD> scanCodes;
+	for (ULONGLONG i = 0; i < CORPUS_EVENTS; i++)
+	{
+		const EventRecord& er = corpus.Raw(i);
+		if (er.message != WM_KEYDOWN || (HIWORD(er.lParam) & KF_REPEAT) || PatternDetector::ModifierOf(er.wParam)) continue;
+		WORD scanCode = LOBYTE(HIWORD(er.lParam));
+		if (HIWORD(er.lParam) & KF_EXTENDED) scanCode = MAKEWORD(scanCode, 0xE0);
+		scanCodes.push_back(scanCode);
+	}
+	if (scanCodes.size() < MAX_GENERATED_RULE) return;
+
+	ULONGLONG random = 0x9E3779B97F4A7C15;
+	for (UINT r = 0; r < cRules; r++)
+	{
+		random ^= random << 13;
+		random ^= random >> 7;
+		random ^= random << 17;
+		UINT cSymbols = MIN_GENERATED_RULE + (UINT)(random % (MAX_GENERATED_RULE - MIN_GENERATED_RULE + 1));
+		size_t first = (size_t)((random >> 8) % (scanCodes.size() - cSymbols));
+		UINT modifiers = (random >> 40) % 4 == 0 ? MOD_CONTROL | MOD_SHIFT : 0;
+
+		KeySymbol symbol[MAX_GENERATED_RULE];
+		for (UINT i = 0; i < cSymbols; i++) symbol[i] = MAKEKEYSYMBOL(scanCodes[first + i], modifiers);
+		detector.AddRule(symbol, cSymbols, 0, _T("Generated"));
+	}
+	detector.Compile();
+}
+
+
+
+//
+//  FUNCTION: BenchDecode(Benchmark&, const Corpus&)
+//
+//  PURPOSE: The message decoding used for the rows, and the naming of the keys.
+//
+//  COMMENTS:
+//
+//        The keyboard rows are formatted twice, as captured and with the scan code and
+//        virtual key code of every message cleared, so that the keys have no names. The
+//        lookups still run, the difference is the cost of writing the names.
+//
+static void BenchDecode(Benchmark& bench, const Corpus& corpus)
+{
+	bench.Run(_T("decode/GetMessageText"), _T("event"), [&](ULONGLONG cOps)
+	{
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++) sum += (ULONGLONG)GetMessageText(corpus.Raw(i).message)[0];
+		return sum;
+	});
+
+	bench.Run(_T("decode/GetExtendedStatus"), _T("event"), [&](ULONGLONG cOps)
+	{
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++) sum += (ULONGLONG)GetExtendedStatus(corpus.Raw(i).lParam)[0];
+		return sum;
+	});
+
+	bench.Run(_T("decode/MouseButtons"), _T("event"), [&](ULONGLONG cOps)
+	{
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++) sum += (ULONGLONG)MouseButtons(corpus.Raw(i).wParam)[0];
+		return sum;
+	});
+
+	std::vector<EventRecord> keys, unnamed;
+	for (ULONGLONG i = 0; i < CORPUS_EVENTS; i++)
+	{
+		EventRecord er = corpus.At(i);
+		if (er.message < WM_KEYFIRST || er.message > WM_KEYLAST) continue;
+		keys.push_back(er);
+		er.wParam = 0;
+		er.lParam &= ~(LPARAM)MAKELONG(0, 0xFF | KF_EXTENDED);
+		unnamed.push_back(er);
+	}
+	if (keys.empty()) return;
+
+	bench.Run(_T("keys/ScanCodeName"), _T("key"), [&](ULONGLONG cOps)
+	{
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++) sum += ScanCodeName(ExtendedScanCode(keys[i % keys.size()].lParam)).cchName;
+		return sum;
+	});
+
+	bench.Run(_T("keys/VirtualKeyName"), _T("key"), [&](ULONGLONG cOps)
+	{
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++) sum += VirtualKeyName((UINT)keys[i % keys.size()].wParam).cchName;
+		return sum;
+	});
+
+	bench.Run(_T("format/FormatRow (keys)"), _T("event"), [&](ULONGLONG cOps)
+	{
+		TCHAR sz[MAX_ROW_LEN];
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++) sum += FormatRow(sz, MAX_ROW_LEN, keys[i % keys.size()]);
+		return sum;
+	});
+
+	bench.Run(_T("format/FormatRow (keys, no names)"), _T("event"), [&](ULONGLONG cOps)
+	{
+		TCHAR sz[MAX_ROW_LEN];
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++) sum += FormatRow(sz, MAX_ROW_LEN, unnamed[i % unnamed.size()]);
+		return sum;
+	});
+}
+
+
+
+//
+//  FUNCTION: BenchStages(Benchmark&, const Corpus&)
+//
+//  PURPOSE: Each stage of RecordEvent() on its own, and the formatting of a row.
+//
+static void BenchStages(Benchmark& bench, const Corpus& corpus)
+{
+	// The history reaches its retention limit in long runs, so eviction is included
+	EventHistory* pHistory = new EventHistory;
+	bench.Run(_T("history/Append"), _T("event"), [&](ULONGLONG cOps)
+	{
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++)
+		{
+			EventRecord er = corpus.At(i);
+			sum += pHistory->Append(er);
+		}
+		return sum;
+	}, [&]() { pHistory->Clear(); });
+	delete pHistory;
+
+	bench.Run(_T("format/FormatRow"), _T("event"), [&](ULONGLONG cOps)
+	{
+		TCHAR sz[MAX_ROW_LEN];
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++) sum += FormatRow(sz, MAX_ROW_LEN, corpus.At(i));
+		return sum;
+	});
+
+	DisplayRows rows;
+	bench.Run(_T("rows/Add"), _T("event"), [&](ULONGLONG cOps)
+	{
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++) sum += rows.Add(corpus.At(i), false);
+		return sum;
+	}, [&]() { rows.Clear(); });
+
+	bench.Run(_T("rows/Add (folded)"), _T("event"), [&](ULONGLONG cOps)
+	{
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++) sum += rows.Add(corpus.At(i), true);
+		return sum;
+	}, [&]() { rows.Clear(); });
+
+	bench.Run(_T("rows/Add (keystrokes)"), _T("event"), [&](ULONGLONG cOps)
+	{
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++) sum += rows.Add(corpus.At(i), false, true);
+		return sum;
+	}, [&]() { rows.Clear(); });
+
+	KeystrokeJoin join;
+	bench.Run(_T("keystrokes/OnEvent"), _T("event"), [&](ULONGLONG cOps)
+	{
+		Keystroke* pks;
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++) sum += join.OnEvent(corpus.At(i), &pks);
+		return sum;
+	}, [&]() { join.Reset(); });
+
+	PatternDetector detector;
+	AddRules(detector);
+	bench.Run(_T("patterns/OnEvent"), _T("event"), [&](ULONGLONG cOps)
+	{
+		PatternMatch pm[MAX_BENCH_MATCHES];
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++) sum += detector.OnEvent(corpus.At(i), pm, MAX_BENCH_MATCHES);
+		return sum;
+	}, [&]() { detector.Reset(); });
+
+	// The cost per message is that of one table lookup whatever the number of rules,
+	// less the cache misses of a larger table
+	for (UINT cRules : generatedRuleCounts)
+	{
+		TCHAR szName[MAX_BENCH_NAME];
+		StringCchPrintf(szName, MAX_BENCH_NAME, _T("patterns/OnEvent (%u rules)"), cRules);
+		if (!bench.Selected(szName)) continue;
+
+		PatternDetector* pGenerated = new PatternDetector;
+		GenerateRules(*pGenerated, corpus, cRules);
+		bench.Run(szName, _T("event"), [&](ULONGLONG cOps)
+		{
+			PatternMatch pm[MAX_BENCH_MATCHES];
+			ULONGLONG sum = 0;
+			for (ULONGLONG i = 0; i < cOps; i++) sum += pGenerated->OnEvent(corpus.At(i), pm, MAX_BENCH_MATCHES);
+			return sum;
+		}, [&]() { pGenerated->Reset(); });
+		delete pGenerated;
+	}
+
+	TypedText* pText = new TypedText;
+	bench.Run(_T("text/OnEvent"), _T("event"), [&](ULONGLONG cOps)
+	{
+		for (ULONGLONG i = 0; i < cOps; i++) pText->OnEvent(corpus.At(i));
+		return (ULONGLONG)pText->Length();
+	}, [&]() { pText->Clear(); });
+
+	// Random words with the query typed once at the end, so the filters must rule out every
+	// block but the last
+	static const TCHAR szFind[] = _T("text/Find (5M chars)");
+	if (bench.Selected(szFind))
+	{
+		static const TCHAR szQuery[] = _T("benchmark query");
+		pText->Clear();
+		ULONGLONG random = 0x2545F4914F6CDD1D;
+		for (UINT sequence = 1; pText->Length() < FIND_TEXT_CHARS; sequence++)
+		{
+			random ^= random << 13;
+			random ^= random >> 7;
+			random ^= random << 17;
+			pText->Insert(random % 6 == 0 ? _T(' ') : (TCHAR)(_T('a') + random / 6 % 26), sequence);
+		}
+		for (const TCHAR* p = szQuery; *p; p++) pText->Insert(*p, 0);
+		bench.Run(szFind, _T("search"), [&](ULONGLONG cOps)
+		{
+			ULONGLONG sum = 0;
+			for (ULONGLONG i = 0; i < cOps; i++) sum += pText->Find(szQuery, 0);
+			return sum;
+		});
+	}
+	delete pText;
+
+	// Through the capture queues and the merge, in batches as the monitor drains them. The
+	// merger and its queues are made fresh before each run, outside the timing
+	std::unique_ptr<EventMerger> pMerger;
+	EventQueue* pQueue[CORPUS_SOURCES];
+	auto newMerger = [&]()
+	{
+		pMerger.reset(new EventMerger);
+		for (UINT source = 0; source < CORPUS_SOURCES; source++)
+		{
+			UINT index;
+			pQueue[source] = pMerger->AddSource(LOAD_QUEUE_CAPACITY, &index);
+		}
+	};
+	bench.Run(_T("merge/PushAndMerge"), _T("event"), [&](ULONGLONG cOps)
+	{
+		ULONGLONG sum = 0;
+		EventRecord er;
+		for (ULONGLONG i = 0; i < cOps; i += PIPELINE_BATCH)
+		{
+			ULONGLONG last = 0;
+			for (ULONGLONG j = i; j < i + PIPELINE_BATCH && j < cOps; j++)
+			{
+				er = corpus.At(j);
+				pQueue[er.source]->Push(er);
+				last = er.timestamp;
+			}
+			for (UINT source = 0; source < CORPUS_SOURCES; source++) pQueue[source]->Heartbeat(last);
+			pMerger->Poll(last);
+			while (pMerger->Next(er)) sum += er.sequence;
+		}
+		return sum;
+	}, newMerger);
+}
+
+
+
+//
+//  FUNCTION: BenchTrajectory(Benchmark&, const Corpus&)
+//
+//  PURPOSE: The trajectory statistics, live per move and as a batch over a long capture.
+//
+//  COMMENTS:
+//
+//        The batch is the moves of one source of the corpus, repeated to TRAJECTORY_SAMPLES
+//        with time moving on, so its timestamps run well past 32 bits of microseconds.
+//
+static void BenchTrajectory(Benchmark& bench, const Corpus& corpus)
+{
+	static const TCHAR szAdd[] = _T("trajectory/Add");
+	static const TCHAR szAnalyze[] = _T("trajectory/Analyze (window)");
+	static const TCHAR szBatch[] = _T("trajectory/AnalyzeTrajectory (4M)");
+	if (!bench.SelectedAny({ szAdd, szAnalyze, szBatch })) return;
+
+	std::vector<float> x, y, scratch;
+	std::vector<ULONGLONG> t;
+	x.reserve(TRAJECTORY_SAMPLES);
+	y.reserve(TRAJECTORY_SAMPLES);
+	t.reserve(TRAJECTORY_SAMPLES);
+	for (ULONGLONG i = 0; t.size() < TRAJECTORY_SAMPLES; i++)
+	{
+		EventRecord er = corpus.At(i);
+		if (er.message != WM_MOUSEMOVE || er.source != 0) continue;
+		x.push_back((float)GET_X_LPARAM(er.lParam));
+		y.push_back((float)GET_Y_LPARAM(er.lParam));
+		t.push_back(er.timestamp);
+	}
+	scratch.resize(TRAJECTORY_SAMPLES);
+
+	TrajectoryAnalyzer* pTrajectory = new TrajectoryAnalyzer;
+	bench.Run(szAdd, _T("sample"), [&](ULONGLONG cOps)
+	{
+		for (ULONGLONG i = 0; i < cOps; i++)
+		{
+			size_t j = (size_t)(i % TRAJECTORY_SAMPLES);
+			pTrajectory->Add((int)x[j], (int)y[j], t[j] + (i / TRAJECTORY_SAMPLES) * (t.back() + 1));
+		}
+		return (ULONGLONG)pTrajectory->Count();
+	}, [&]() { pTrajectory->Reset(); });
+
+	// A full window, whether or not the benchmark above filled it
+	if (pTrajectory->Count() < TRAJECTORY_WINDOW)
+	{
+		for (size_t j = 0; j < TRAJECTORY_WINDOW; j++) pTrajectory->Add((int)x[j], (int)y[j], t[j]);
+	}
+	bench.Run(szAnalyze, _T("window"), [&](ULONGLONG cOps)
+	{
+		TrajectoryStats ts;
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++)
+		{
+			pTrajectory->Analyze(&ts);
+			sum += ts.cIntervals;
+		}
+		return sum;
+	});
+	delete pTrajectory;
+
+	bench.Run(szBatch, _T("sample"), [&](ULONGLONG cOps)
+	{
+		TrajectoryStats ts;
+		ULONGLONG sum = 0;
+		for (ULONGLONG done = 0; done < cOps; done += TRAJECTORY_SAMPLES)
+		{
+			UINT n = (UINT)(cOps - done < TRAJECTORY_SAMPLES ? cOps - done : TRAJECTORY_SAMPLES);
+			AnalyzeTrajectory(x.data(), y.data(), t.data(), n, scratch.data(), &ts);
+			sum += ts.cIntervals;
+		}
+		return sum;
+	});
+}
+
+
+
+//
+//  FUNCTION: BenchSettings(Benchmark&)
+//
+//  PURPOSE: Saving and loading a block of settings, as the window placement and font are.
+//
+//  COMMENTS:
+//
+//        The block is an entry of its own in the settings of the monitor, deleted at the end.
+//
+static void BenchSettings(Benchmark& bench)
+{
+	static const TCHAR szSave[] = _T("settings/SaveMemoryBlock");
+	static const TCHAR szLoad[] = _T("settings/LoadMemoryBlock");
+	if (!bench.SelectedAny({ szSave, szLoad })) return;
+
+	ApplicationRegistry registry;
+	if (!registry.Init((HWND)1)) return;
+
+	BYTE block[SETTINGS_BLOCK];
+	for (UINT i = 0; i < SETTINGS_BLOCK; i++) block[i] = (BYTE)i;
+	bench.Run(szSave, _T("op"), [&](ULONGLONG cOps)
+	{
+		ULONGLONG sum = 0;
+		for (ULONGLONG i = 0; i < cOps; i++)
+		{
+			block[0] = (BYTE)i;
+			sum += registry.SaveMemoryBlock(_T("Benchmark"), block, SETTINGS_BLOCK);
+		}
+		return sum;
+	});
+
+	// There is a block to load, whether or not the benchmark above saved it
+	if (bench.Selected(szLoad) && registry.SaveMemoryBlock(_T("Benchmark"), block, SETTINGS_BLOCK))
+	{
+		bench.Run(szLoad, _T("op"), [&](ULONGLONG cOps)
+		{
+			ULONGLONG sum = 0;
+			for (ULONGLONG i = 0; i < cOps; i++)
+			{
+				sum += registry.LoadMemoryBlock(_T("Benchmark"), block, SETTINGS_BLOCK) + block[0];
+			}
+			return sum;
+		});
+	}
+	registry.DeleteMemoryBlock(_T("Benchmark"));
+}
+
+
+
+//
+//  FUNCTION: BenchPipeline(Benchmark&, const Corpus&)
+//
+//  PURPOSE: All of the stages together, as the monitor runs them for each message.
+//
+//  COMMENTS:
+//
+//        The messages go through the capture queues and the merge, then RecordEvent() -
+//        history, rows, patterns, typed text, heat map and trajectories - and the top row
+//        is formatted, as painting it would. The heat map covers a 4K screen. As in the
+//        monitor, only the keys of source 0 are matched to patterns and typed.
+//
+static void BenchPipeline(Benchmark& bench, const Corpus& corpus)
+{
+	static const TCHAR szPipeline[] = _T("pipeline/end-to-end");
+	if (!bench.Selected(szPipeline)) return;
+
+	EventHistory* pHistory = new EventHistory;
+	DisplayRows* pRows = new DisplayRows;
+	PatternDetector* pDetector = new PatternDetector;
+	TypedText* pText = new TypedText;
+	HeatMap* pHeatMap = new HeatMap;
+	TrajectoryAnalyzer* pTrajectory = new TrajectoryAnalyzer[CORPUS_SOURCES];
+	AddRules(*pDetector);
+	pHeatMap->Init(0, 0, 3840, 2160);
+
+	std::unique_ptr<EventMerger> pMerger;
+	EventQueue* pQueue[CORPUS_SOURCES];
+	auto setup = [&]()
+	{
+		pMerger.reset(new EventMerger);
+		for (UINT source = 0; source < CORPUS_SOURCES; source++)
+		{
+			UINT index;
+			pQueue[source] = pMerger->AddSource(LOAD_QUEUE_CAPACITY, &index);
+		}
+		pHistory->Clear();
+		pRows->Clear();
+		pDetector->Reset();
+		pText->Clear();
+		pHeatMap->Clear();
+		for (UINT source = 0; source < CORPUS_SOURCES; source++) pTrajectory[source].Reset();
+	};
+
+	bench.Run(szPipeline, _T("event"), [&](ULONGLONG cOps)
+	{
+		TCHAR sz[MAX_ROW_LEN];
+		PatternMatch pm[MAX_BENCH_MATCHES];
+		ULONGLONG sum = 0;
+		EventRecord er;
+		for (ULONGLONG i = 0; i < cOps; i += PIPELINE_BATCH)
+		{
+			ULONGLONG last = 0;
+			for (ULONGLONG j = i; j < i + PIPELINE_BATCH && j < cOps; j++)
+			{
+				er = corpus.At(j);
+				pQueue[er.source]->Push(er);
+				last = er.timestamp;
+			}
+			for (UINT source = 0; source < CORPUS_SOURCES; source++) pQueue[source]->Heartbeat(last);
+			pMerger->Poll(last);
+			while (pMerger->Next(er))
+			{
+				pHistory->Append(er);
+				UINT changed = pRows->Add(er, true);
+				if (er.source == 0) sum += pDetector->OnEvent(er, pm, MAX_BENCH_MATCHES);
+				if (er.source == 0) pText->OnEvent(er);
+				if (er.message >= WM_MOUSEFIRST && er.message <= WM_MOUSELAST && er.message != WM_MOUSEWHEEL)
+				{
+					int x = GET_X_LPARAM(er.lParam);
+					int y = GET_Y_LPARAM(er.lParam);
+					pHeatMap->AddMessage(er.message, x, y);
+					if (er.message == WM_MOUSEMOVE) pTrajectory[er.source].Add(x, y, er.timestamp);
+				}
+				if (changed != ROWS_UNCHANGED)
+				{
+					const DisplayRow& row = pRows->Row(0);
+					sum += row.cRepeats ? FormatFoldedRow(sz, MAX_ROW_LEN, row) : FormatRow(sz, MAX_ROW_LEN, row.er);
+				}
+			}
+		}
+		return sum + pHistory->Last() + pText->Length();
+	}, setup);
+
+	delete[] pTrajectory;
+	delete pHeatMap;
+	delete pText;
+	delete pDetector;
+	delete pRows;
+	delete pHistory;
+}
+
+
+
+//
+//  FUNCTION: _tmain(int, TCHAR*[])
+//
+//  PURPOSE: Parses the options and runs the benchmarks.
+//
+int _tmain(int argc, TCHAR* argv[])
+{
+	Benchmark bench;
+	const TCHAR* pszJson = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		if (_tcscmp(argv[i], _T("--filter")) == 0 && i + 1 < argc) bench.SetFilter(argv[++i]);
+		else if (_tcscmp(argv[i], _T("--min-time")) == 0 && i + 1 < argc) bench.SetMinSeconds(_tcstod(argv[++i], NULL));
+		else if (_tcscmp(argv[i], _T("--json")) == 0 && i + 1 < argc) pszJson = argv[++i];
+		else if (_tcscmp(argv[i], _T("--compare")) == 0 && i + 1 < argc)
+		{
+			if (!bench.LoadBaseline(argv[++i]))
+			{
+				_ftprintf(stderr, _T("Cannot read %s\n"), argv[i]);
+				return 1;
+			}
+		}
+		else
+		{
+			_ftprintf(stderr, _T("Usage: KeyboardMouseBench [--filter text] [--min-time seconds] ")
+				_T("[--json results.json] [--compare baseline.json]\n"));
+			return 1;
+		}
+	}
+
+	Corpus corpus;
+	BenchDecode(bench, corpus);
+	BenchStages(bench, corpus);
+	BenchTrajectory(bench, corpus);
+	BenchSettings(bench);
+	BenchPipeline(bench, corpus);
+	bench.Print();
+
+	if (pszJson && !bench.WriteJson(pszJson))
+	{
+		_ftprintf(stderr, _T("Cannot write %s\n"), pszJson);
+		return 1;
+	}
+	return 0;
+}
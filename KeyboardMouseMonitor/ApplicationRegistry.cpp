@@ -305,6 +305,31 @@ BOOL ApplicationRegistry::SaveMemoryBlock(const TCHAR* pszEntry, const BYTE* lpM
 	else return TRUE;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Delete a memory block from the registry
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL ApplicationRegistry::DeleteMemoryBlock(const TCHAR* pszEntry)
+{
+	// Verify that Init() has been called
+	_LastAPICallLine = __LINE__ + 1;
+	if (_hWnd == 0)
+	{
+		_LastErrorNumber = ERROR_APP_INIT_FAILURE;
+		_isOK = false;
+		return false;
+	}
+
+	// Delete the memory block from the registry
+	HKEY hKey;
+	_LastAPICallLine = __LINE__ + 1;
+	LSTATUS ls1 = RegOpenKeyEx(HKEY_CURRENT_USER, _szRegistrySubKey, 0, KEY_WRITE, &hKey);
+	if (ls1 != ERROR_SUCCESS) return false; // No error handling, as there is nothing to delete
+	_LastAPICallLine = __LINE__ + 1;
+	LSTATUS ls2 = RegDeleteValue(hKey, pszEntry);
+	RegCloseKey(hKey);
+	return ls2 == ERROR_SUCCESS;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // Display API Error information
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -22,6 +22,7 @@ public:
 	BOOL Init(HWND hWnd);
 	BOOL LoadMemoryBlock(const TCHAR* pszEntry,       BYTE *lpMemoryBlock, DWORD cbMemoryBlock);
 	BOOL SaveMemoryBlock(const TCHAR *pszEntry, const BYTE *lpMemoryBlock, DWORD cbMemoryBlock);
+	BOOL DeleteMemoryBlock(const TCHAR *pszEntry);
 	BOOL isOK() { return _isOK; }
 	void DisplayAPIError();
 };
@@ -0,0 +1,203 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CaptureFile.cpp : Provides the reading and writing of capture files, the recorded messages on disk.
+//
+//                   The records have a fixed layout so that a reader can map the file and use
+//                   the records in place, however large the file is.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "CaptureFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(CaptureHeader) == 24, "CaptureHeader must not depend on the build");
+static_assert(sizeof(CaptureRecord) == 40, "CaptureRecord must not depend on the build");
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+CaptureWriter::CaptureWriter()
+{
+	_pFile = NULL;
+	_cRecords = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Destructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+CaptureWriter::~CaptureWriter()
+{
+	Close();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Create the file and write a header with no record count yet
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL CaptureWriter::Open(const TCHAR* pszPath, DWORD generation)
+{
+	Close();
+	if (_tfopen_s(&_pFile, pszPath, _T("wb")) != 0 || _pFile == NULL)
+	{
+		_pFile = NULL;
+		return false;
+	}
+
+	CaptureHeader ch;
+	ZeroMemory(&ch, sizeof(ch));
+	ch.magic = CAPTURE_MAGIC;
+	ch.version = CAPTURE_VERSION;
+	ch.recordSize = sizeof(CaptureRecord);
+	ch.generation = generation;
+	_cRecords = 0;
+	return fwrite(&ch, sizeof(ch), 1, _pFile) == 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Append a record
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL CaptureWriter::Write(const EventRecord& er)
+{
+	if (_pFile == NULL) return false;
+
+	CaptureRecord cr;
+	cr.sequence = er.sequence;
+	cr.message = er.message;
+	cr.wParam = (ULONGLONG)er.wParam;
+	cr.lParam = (ULONGLONG)(LONGLONG)er.lParam;
+	cr.timestamp = er.timestamp;
+	cr.source = er.source;
+	cr.reserved = 0;
+	if (fwrite(&cr, sizeof(cr), 1, _pFile) != 1) return false;
+	_cRecords++;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Fill in the record count and close the file - Returns false if anything failed to be written
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL CaptureWriter::Close()
+{
+	if (_pFile == NULL) return true;
+
+	BOOL bOK = fseek(_pFile, offsetof(CaptureHeader, cRecords), SEEK_SET) == 0 &&
+		fwrite(&_cRecords, sizeof(_cRecords), 1, _pFile) == 1;
+	if (fclose(_pFile) != 0) bOK = false;
+	_pFile = NULL;
+	return bOK;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+CaptureFile::CaptureFile()
+{
+#ifdef _WIN32
+	_hFile = INVALID_HANDLE_VALUE;
+	_hMapping = NULL;
+#else
+	_fd = -1;
+	_cbMapped = 0;
+#endif
+	_pView = NULL;
+	_pRecords = NULL;
+	_cRecords = 0;
+	_generation = 0;
+	_isComplete = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Destructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+CaptureFile::~CaptureFile()
+{
+	Close();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Map a capture file - Returns false if it cannot be mapped or is not a capture file
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL CaptureFile::Open(const TCHAR* pszPath)
+{
+	Close();
+
+	ULONGLONG cbFile = 0;
+#ifdef _WIN32
+	_hFile = CreateFile(pszPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (_hFile == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_hFile, &size) || size.QuadPart < (LONGLONG)sizeof(CaptureHeader))
+	{
+		Close();
+		return false;
+	}
+	cbFile = size.QuadPart;
+	_hMapping = CreateFileMapping(_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_hMapping) _pView = (const BYTE*)MapViewOfFile(_hMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	_fd = open(pszPath, O_RDONLY);
+	if (_fd < 0) return false;
+	struct stat st;
+	if (fstat(_fd, &st) != 0 || st.st_size < (off_t)sizeof(CaptureHeader))
+	{
+		Close();
+		return false;
+	}
+	cbFile = st.st_size;
+	void* pView = mmap(NULL, (size_t)cbFile, PROT_READ, MAP_SHARED, _fd, 0);
+	if (pView != MAP_FAILED)
+	{
+		_pView = (const BYTE*)pView;
+		_cbMapped = (size_t)cbFile;
+	}
+#endif
+	if (_pView == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	const CaptureHeader* pHeader = (const CaptureHeader*)_pView;
+	if (pHeader->magic != CAPTURE_MAGIC || pHeader->version != CAPTURE_VERSION ||
+		pHeader->recordSize != sizeof(CaptureRecord))
+	{
+		Close();
+		return false;
+	}
+
+	// Trust the header only as far as the file goes
+	ULONGLONG cComplete = (cbFile - sizeof(CaptureHeader)) / sizeof(CaptureRecord);
+	_cRecords = pHeader->cRecords && pHeader->cRecords < cComplete ? pHeader->cRecords : cComplete;
+	_generation = pHeader->generation;
+	_isComplete = pHeader->cRecords && pHeader->cRecords <= cComplete;
+	_pRecords = (const CaptureRecord*)(_pView + sizeof(CaptureHeader));
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Unmap the file
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void CaptureFile::Close()
+{
+#ifdef _WIN32
+	if (_pView) UnmapViewOfFile(_pView);
+	if (_hMapping) CloseHandle(_hMapping);
+	if (_hFile != INVALID_HANDLE_VALUE) CloseHandle(_hFile);
+	_hFile = INVALID_HANDLE_VALUE;
+	_hMapping = NULL;
+#else
+	if (_pView) munmap((void*)_pView, _cbMapped);
+	if (_fd >= 0) close(_fd);
+	_fd = -1;
+	_cbMapped = 0;
+#endif
+	_pView = NULL;
+	_pRecords = NULL;
+	_cRecords = 0;
+	_generation = 0;
+	_isComplete = false;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "framework.h"
+#include "EventRecord.h"
+
+#include <stdio.h>
+
+#define CAPTURE_MAGIC 0x434D4D4B                // "KMMC"
+#define CAPTURE_VERSION 1
+
+// A capture file is this header followed by the records, oldest first
+struct CaptureHeader
+{
+	DWORD     magic;
+	DWORD     version;
+	DWORD     recordSize;                       // sizeof(CaptureRecord)
+	DWORD     generation;                       // Counts the saves of a history snapshot, 0 for a capture
+	ULONGLONG cRecords;                         // 0 while the file is being written
+};
+
+// A recorded message as stored in a capture file - The same on 32 and 64 bit builds
+struct CaptureRecord
+{
+	UINT      sequence;
+	UINT      message;
+	ULONGLONG wParam;
+	ULONGLONG lParam;
+	ULONGLONG timestamp;
+	UINT      source;
+	UINT      reserved;
+};
+
+inline void FromCaptureRecord(const CaptureRecord& cr, EventRecord* per)
+{
+	per->sequence = cr.sequence;
+	per->message = cr.message;
+	per->wParam = (WPARAM)cr.wParam;
+	per->lParam = (LPARAM)cr.lParam;
+	per->timestamp = cr.timestamp;
+	per->source = cr.source;
+}
+
+// Writes a capture file
+class CaptureWriter
+{
+private:
+	FILE*     _pFile;
+	ULONGLONG _cRecords;
+public:
+	CaptureWriter();
+	~CaptureWriter();
+	CaptureWriter(const CaptureWriter&) = delete;
+	CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+	BOOL Open(const TCHAR* pszPath, DWORD generation = 0);
+	BOOL Write(const EventRecord& er);
+	BOOL Close();
+	ULONGLONG Records() const { return _cRecords; }
+};
+
+// Maps a capture file into memory for reading.
+//
+// Nothing is parsed or copied: Records() points into the mapping. A file whose writer did
+// not finish has a record count of 0 in its header; its complete records are still read.
+class CaptureFile
+{
+private:
+#ifdef _WIN32
+	HANDLE _hFile;
+	HANDLE _hMapping;
+#else
+	int    _fd;
+	size_t _cbMapped;
+#endif
+	const BYTE*          _pView;
+	const CaptureRecord* _pRecords;
+	ULONGLONG            _cRecords;
+	DWORD                _generation;
+	BOOL                 _isComplete;
+public:
+	CaptureFile();
+	~CaptureFile();
+	CaptureFile(const CaptureFile&) = delete;
+	CaptureFile& operator=(const CaptureFile&) = delete;
+
+	BOOL Open(const TCHAR* pszPath);
+	void Close();
+	const CaptureRecord* Records() const { return _pRecords; }
+	ULONGLONG Count() const { return _cRecords; }
+	DWORD Generation() const { return _generation; }
+	BOOL isComplete() const { return _isComplete; }     // The writer finished the file
+};
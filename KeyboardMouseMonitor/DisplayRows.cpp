@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// DisplayRows.cpp : Provides the rows on display, with optional folding of key autorepeat
+//                   and joining of keystrokes.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "DisplayRows.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+DisplayRows::DisplayRows()
+{
+	Clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Remove every row
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void DisplayRows::Clear()
+{
+	ZeroMemory(_row, sizeof(_row));
+	_top = 0;
+	_cRows = 0;
+	_cShifted = 0;
+	_join.Reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// An autorepeated key down, or a character produced by one
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL DisplayRows::IsRepeat(const EventRecord& er)
+{
+	if (er.message != WM_KEYDOWN && er.message != WM_SYSKEYDOWN &&
+		er.message != WM_CHAR && er.message != WM_SYSCHAR) return false;
+	return (HIWORD(er.lParam) & KF_REPEAT) != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Shift the rows down by one, making room for a new top row - The bottom row is reused
+///////////////////////////////////////////////////////////////////////////////////////////////////
+DisplayRow& DisplayRows::Shift()
+{
+	_top = (_top + MAX_MESSAGES - 1) % MAX_MESSAGES;
+	if (_cRows < MAX_MESSAGES) _cRows++;
+	_cShifted++;
+	return _row[_top];
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Join a keyboard message into the row of its keystroke - *pbJoined is false if it was not
+// joined and needs a row of its own
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT DisplayRows::Join(const EventRecord& er, BOOL* pbJoined)
+{
+	Keystroke* pks;
+	UINT result = _join.OnEvent(er, &pks);
+	*pbJoined = result != KEYSTROKE_NONE;
+	if (result == KEYSTROKE_NONE) return ROWS_UNCHANGED;
+
+	// A new keystroke gets the top row, and keeps its number to find it again
+	UINT i = 0;
+	if (result == KEYSTROKE_STARTED)
+	{
+		DisplayRow& top = Shift();
+		top.er = pks->down;
+		top.bKeystroke = true;
+		pks->row = _cShifted;
+	}
+	else
+	{
+		i = _cShifted - pks->row;
+		if (i >= _cRows || !Row(i).bKeystroke || Row(i).er.sequence != pks->down.sequence) return ROWS_UNCHANGED; // Scrolled off
+	}
+
+	DisplayRow& row = _row[(_top + i) % MAX_MESSAGES];
+	row.cRepeats = pks->cRepeats;
+	row.cChars = pks->cChars;
+	row.lastSequence = pks->lastSequence;
+	row.lastTimestamp = pks->upTimestamp ? pks->upTimestamp : pks->down.timestamp;
+	row.ch = pks->ch;
+	row.modifiers = pks->modifiers;
+	row.upTimestamp = pks->upTimestamp;
+	return result == KEYSTROKE_STARTED ? ROWS_SHIFTED : i == 0 ? ROWS_TOP_UPDATED : ROWS_UPDATED;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Add a recorded message - Returns ROWS_TOP_UPDATED if it was folded into the top row, or
+// joined into the keystroke there, and ROWS_UPDATED if joined into a keystroke further down
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT DisplayRows::Add(const EventRecord& er, BOOL bFold, BOOL bJoin)
+{
+	if (bJoin)
+	{
+		BOOL bJoined;
+		UINT rows = Join(er, &bJoined);
+		if (bJoined) return rows;
+	}
+
+	if (bFold && IsRepeat(er))
+	{
+		// Fold into the run at the top if it is a run of the same key (scan code and extended bit)
+		// from the same capture source, so the copies that raw input records are not counted twice
+		DisplayRow& top = _row[_top];
+		const WORD keyMask = 0x00FF | KF_EXTENDED;
+		if (_cRows && top.cRepeats && !top.bKeystroke && top.er.source == er.source &&
+			(HIWORD(top.er.lParam) & keyMask) == (HIWORD(er.lParam) & keyMask))
+		{
+			if (er.message == WM_KEYDOWN || er.message == WM_SYSKEYDOWN) top.cRepeats++;
+			else top.cChars++;
+			top.lastSequence = er.sequence;
+			top.lastTimestamp = er.timestamp;
+			return ROWS_TOP_UPDATED;
+		}
+	}
+
+	// A repeated key down starts a new run, anything else is a plain row
+	DisplayRow& top = Shift();
+	top.er = er;
+	top.cRepeats = bFold && IsRepeat(er) && (er.message == WM_KEYDOWN || er.message == WM_SYSKEYDOWN) ? 1 : 0;
+	top.cChars = 0;
+	top.lastSequence = er.sequence;
+	top.lastTimestamp = er.timestamp;
+	top.bKeystroke = false;
+	return ROWS_SHIFTED;
+}
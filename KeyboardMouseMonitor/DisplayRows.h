@@ -0,0 +1,59 @@
+#pragma once
+#include "framework.h"
+#include "EventRecord.h"
+#include "KeystrokeJoin.h"
+
+#define MAX_MESSAGES 50                     // Number of rows displayed
+
+// Result of DisplayRows::Add()
+#define ROWS_UNCHANGED 0
+#define ROWS_TOP_UPDATED 1                  // Only the top row changed
+#define ROWS_UPDATED 2                      // Rows below the top changed in place
+#define ROWS_SHIFTED 3                      // A new row was added at the top
+
+// One displayed row: a message, a run of key autorepeat folded together, or a keystroke
+struct DisplayRow
+{
+	EventRecord er;                         // The message, the first repeat of the run, or the key down
+	UINT        cRepeats;                   // Repeated key downs in the run, 0 for a plain message
+	UINT        cChars;                     // Repeated characters folded into the run
+	UINT        lastSequence;
+	ULONGLONG   lastTimestamp;
+	BOOL        bKeystroke;                 // A keystroke, with cRepeats and cChars of its own
+	TCHAR       ch;                         // Of a keystroke, the first character it produced
+	UINT        modifiers;                  // Of a keystroke, MOD_* held when the key went down
+	ULONGLONG   upTimestamp;                // Of a keystroke, 0 while the key is held
+};
+
+// The rows on display, newest first.
+//
+// When folding is on, consecutive autorepeats (KF_REPEAT) of the same key from the same
+// capture source - key downs and the characters they produce - update a single row with the
+// repeat count, the first and last timestamps and the rate, instead of pushing a row each. The raw messages stay in
+// the EventHistory, from the first sequence number of the row to its last.
+//
+// When joining is on, the key down, autorepeat, characters and key up of each key press
+// are shown as one keystroke row, added at the key down and updated in place as the rest
+// arrives (see KeystrokeJoin). Each keystroke in flight keeps the number of its row, so
+// the row to update is found without a search, or known to have scrolled off.
+//
+// The rows are kept in a ring, so adding one moves the top rather than the rows.
+class DisplayRows
+{
+private:
+	DisplayRow    _row[MAX_MESSAGES];
+	UINT          _top;                     // Index in _row[] of the top row
+	UINT          _cRows;
+	UINT          _cShifted;                // Rows added since Clear(), the number of the top row
+	KeystrokeJoin _join;
+
+	static BOOL IsRepeat(const EventRecord& er);
+	DisplayRow& Shift();
+	UINT Join(const EventRecord& er, BOOL* pbJoined);
+public:
+	DisplayRows();
+	void Clear();
+	UINT Add(const EventRecord& er, BOOL bFold, BOOL bJoin = false);
+	const DisplayRow& Row(UINT i) const { return _row[(_top + i) % MAX_MESSAGES]; }
+	UINT Rows() const { return _cRows; }
+};
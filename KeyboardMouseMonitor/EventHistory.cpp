@@ -0,0 +1,197 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// EventHistory.cpp : Provides the store of every recorded message, addressed by sequence number.
+//
+//                    The display shows only the newest messages, possibly folded together,
+//                    while the history keeps each raw message retrievable.
+//
+//                    Snapshots share the chunks with the live history. The chunk directory is
+//                    copied only when the live history changes it while a snapshot holds it,
+//                    which happens at most once per chunk. Chunks that have passed retention
+//                    but are still held by snapshots count against MAX_SNAPSHOT_CHUNKS; beyond
+//                    that the oldest snapshots are released.
+//
+//                    The history of an earlier session can be restored from a mapped capture
+//                    file. Its records are converted only when they are looked up, and numbering
+//                    continues after them. They are dropped once the live history reaches its
+//                    retention limit, so the history never has a gap.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "EventHistory.h"
+
+#include <limits.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Look up a record in a directory
+///////////////////////////////////////////////////////////////////////////////////////////////////
+static BOOL DirectoryGet(const HistoryDirectory& d, UINT first, UINT last, UINT sequence, EventRecord* per)
+{
+	if (sequence < first || sequence > last || sequence == 0) return false;
+
+	if (d.pRestored && sequence - d.restoredFirst < d.pRestored->Count())
+	{
+		FromCaptureRecord(d.pRestored->Records()[sequence - d.restoredFirst], per);
+		per->sequence = sequence;
+		return true;
+	}
+
+	UINT chunk = (sequence - 1) / HISTORY_CHUNK - d.firstChunk;
+	*per = d.chunks[chunk][(sequence - 1) % HISTORY_CHUNK];
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Retrieve a record of a snapshot - Returns false if the snapshot was released
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL HistorySnapshot::Get(UINT sequence, EventRecord* per) const
+{
+	if (!isValid()) return false;
+	return DirectoryGet(*_pPin->pDirectory, _pPin->first, _pPin->last, sequence, per);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+EventHistory::EventHistory()
+{
+	_pDirectory = std::make_shared<HistoryDirectory>();
+	_pDirectory->firstChunk = 0;
+	_pDirectory->restoredFirst = 0;
+	_last = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Release every record - Snapshots keep what they hold
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void EventHistory::Clear()
+{
+	_pDirectory = std::make_shared<HistoryDirectory>();
+	_pDirectory->firstChunk = 0;
+	_pDirectory->restoredFirst = 0;
+	_last = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Start from the records of a mapped capture file - Returns the number of records restored
+// The history must be empty. The file stays mapped while the history or a snapshot uses it.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT EventHistory::Restore(const std::shared_ptr<const CaptureFile>& pFile)
+{
+	if (_last || !pFile || pFile->Count() == 0 || pFile->Count() >= UINT_MAX / 2) return 0;
+
+	// Keep the numbering of the file unless it would not fit
+	UINT cRecords = (UINT)pFile->Count();
+	UINT first = pFile->Records()[0].sequence;
+	if (first == 0 || first > UINT_MAX - cRecords) first = 1;
+
+	HistoryDirectory* pDirectory = Writable();
+	pDirectory->pRestored = pFile;
+	pDirectory->restoredFirst = first;
+	_last = first + cRecords - 1;
+	pDirectory->firstChunk = _last / HISTORY_CHUNK;
+	return cRecords;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The sequence number of the oldest record retained, 0 when empty
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT EventHistory::First() const
+{
+	if (_pDirectory->pRestored) return _pDirectory->restoredFirst;
+	return _last ? _pDirectory->firstChunk * HISTORY_CHUNK + 1 : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The directory, copied first if a snapshot shares it
+///////////////////////////////////////////////////////////////////////////////////////////////////
+HistoryDirectory* EventHistory::Writable()
+{
+	if (_pDirectory.use_count() > 1)
+	{
+		_pDirectory = std::make_shared<HistoryDirectory>(*_pDirectory);
+	}
+	return _pDirectory.get();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Add a record, assigning its sequence number - Returns the sequence number
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT EventHistory::Append(EventRecord& er)
+{
+	UINT index = _last % HISTORY_CHUNK;
+	if (index == 0 || _pDirectory->chunks.empty())
+	{
+		// Start a new chunk, releasing the oldest one beyond the retention limit, and with it
+		// the restored records that came before it
+		HistoryDirectory* pDirectory = Writable();
+		if (pDirectory->chunks.size() == MAX_HISTORY_CHUNKS)
+		{
+			HistoryChunk& oldest = pDirectory->chunks.front();
+			if (oldest.use_count() > 1) _retired.push_back(oldest);
+			pDirectory->chunks.erase(pDirectory->chunks.begin());
+			pDirectory->firstChunk++;
+			pDirectory->pRestored.reset();
+			EnforceBudget();
+		}
+		pDirectory->chunks.push_back(HistoryChunk(new EventRecord[HISTORY_CHUNK]));
+	}
+
+	// Records up to _last are never written again, so snapshots can share this chunk
+	er.sequence = ++_last;
+	_pDirectory->chunks.back()[index] = er;
+	return er.sequence;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Retrieve a record - Returns false if it was never recorded or is no longer retained
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL EventHistory::Get(UINT sequence, EventRecord* per) const
+{
+	return DirectoryGet(*_pDirectory, First(), _last, sequence, per);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Take an immutable view of the history as it is now - O(1)
+// A snapshot that is not releasable is never released by the budget, so it may be read on
+// another thread; it should be held only briefly.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+HistorySnapshot EventHistory::Snapshot(BOOL bReleasable)
+{
+	HistorySnapshot snapshot;
+	snapshot._pPin = std::make_shared<HistoryPin>();
+	snapshot._pPin->pDirectory = _pDirectory;
+	snapshot._pPin->first = First();
+	snapshot._pPin->last = _last;
+	if (bReleasable) _pins.push_back(snapshot._pPin);
+	return snapshot;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Release the oldest snapshots while they hold more than MAX_SNAPSHOT_CHUNKS retired chunks
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void EventHistory::EnforceBudget()
+{
+	for (;;)
+	{
+		// Forget the chunks and snapshots that are already gone
+		size_t j = 0;
+		for (size_t i = 0; i < _retired.size(); i++)
+		{
+			if (!_retired[i].expired()) _retired[j++] = _retired[i];
+		}
+		_retired.resize(j);
+		j = 0;
+		for (size_t i = 0; i < _pins.size(); i++)
+		{
+			std::shared_ptr<HistoryPin> pPin = _pins[i].lock();
+			if (pPin && pPin->pDirectory) _pins[j++] = _pins[i];
+		}
+		_pins.resize(j);
+
+		if (_retired.size() <= MAX_SNAPSHOT_CHUNKS || _pins.empty()) return;
+
+		// Release the oldest snapshot; its holder sees it as no longer valid
+		std::shared_ptr<HistoryPin> pOldest = _pins.front().lock();
+		if (pOldest) pOldest->pDirectory.reset();
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "framework.h"
+#include "EventRecord.h"
+#include "CaptureFile.h"
+
+#include <memory>
+#include <vector>
+
+#define HISTORY_CHUNK 4096                  // Records per chunk, power of two
+#define MAX_HISTORY_CHUNKS 1024             // Retention, the oldest chunk is released beyond this
+#define MAX_SNAPSHOT_CHUNKS 256             // Chunks that snapshots may keep alive past retention
+
+typedef std::shared_ptr<EventRecord[]> HistoryChunk;
+
+// The chunks of the history at one point in time. Once a snapshot shares a directory it is
+// never modified again; the live history copies it before its next change (copy-on-write).
+struct HistoryDirectory
+{
+	std::vector<HistoryChunk> chunks;       // Oldest first
+	UINT firstChunk;                        // Chunk number of chunks[0]
+	std::shared_ptr<const CaptureFile> pRestored;   // Records of an earlier session, before the chunks
+	UINT restoredFirst;                     // Sequence number of the first restored record
+};
+
+// What a snapshot holds on to - Released by the history when the memory budget is exceeded
+struct HistoryPin
+{
+	std::shared_ptr<const HistoryDirectory> pDirectory;
+	UINT first;
+	UINT last;
+};
+
+// An immutable view of the history as it was when the snapshot was taken.
+// Taking one is O(1): the chunks, including the partly filled newest one, are shared with
+// the live history, whose records up to the snapshot never change.
+class HistorySnapshot
+{
+	friend class EventHistory;
+private:
+	std::shared_ptr<HistoryPin> _pPin;
+public:
+	BOOL isValid() const { return _pPin && _pPin->pDirectory; }
+	UINT First() const { return isValid() ? _pPin->first : 0; }
+	UINT Last() const { return isValid() ? _pPin->last : 0; }
+	BOOL Get(UINT sequence, EventRecord* per) const;
+	void Release() { _pPin.reset(); }
+};
+
+// Append-only store of every recorded message, in chunks of HISTORY_CHUNK records.
+// Records are addressed by sequence number, which starts at 1 and is assigned by Append().
+class EventHistory
+{
+private:
+	std::shared_ptr<HistoryDirectory>    _pDirectory;
+	UINT                                 _last;         // Sequence number of the newest record, 0 when empty
+	std::vector<std::weak_ptr<HistoryPin>> _pins;       // Snapshots taken, oldest first
+	std::vector<std::weak_ptr<EventRecord[]>> _retired; // Chunks past retention that snapshots may still hold
+
+	HistoryDirectory* Writable();
+	void EnforceBudget();
+public:
+	EventHistory();
+	EventHistory(const EventHistory&) = delete;
+	EventHistory& operator=(const EventHistory&) = delete;
+
+	UINT Append(EventRecord& er);
+	BOOL Get(UINT sequence, EventRecord* per) const;
+	void Clear();
+	UINT Restore(const std::shared_ptr<const CaptureFile>& pFile);
+	HistorySnapshot Snapshot(BOOL bReleasable = true);
+
+	UINT First() const;
+	UINT Last() const { return _last; }
+	UINT RetiredChunks() const { return (UINT)_retired.size(); }
+};
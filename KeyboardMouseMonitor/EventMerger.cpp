@@ -0,0 +1,174 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// EventMerger.cpp : Provides a k-way merge of the capture source queues
+//                   into a single timestamp ordered stream for the history.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "EventMerger.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+EventMerger::EventMerger()
+{
+	for (UINT i = 0; i < MAX_SOURCES; i++) _pQueue[i] = NULL;
+	_cSources.store(0, std::memory_order_relaxed);
+	_cHeap = 0;
+	_window = DEFAULT_REORDER_WINDOW;
+	_now = 0;
+	_stall = 0;
+	_lastReleased = 0;
+	_cLate = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Destructor
+// The merger owns the queues. The producers must have stopped before it is destroyed.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+EventMerger::~EventMerger()
+{
+	for (UINT i = 0; i < MAX_SOURCES; i++) delete _pQueue[i];
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Create the queue for a new capture source
+// Returns NULL when all source slots are in use
+///////////////////////////////////////////////////////////////////////////////////////////////////
+EventQueue* EventMerger::AddSource(UINT cCapacity, UINT* pSource)
+{
+	std::lock_guard<std::mutex> lock(_mtxAdd);
+	UINT source = _cSources.load(std::memory_order_relaxed);
+	if (source == MAX_SOURCES) return NULL;
+
+	_pQueue[source] = new EventQueue(cCapacity);
+	_cSources.store(source + 1, std::memory_order_release);
+	if (pSource) *pSource = source;
+	return _pQueue[source];
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Heap ordering - by timestamp, then by source so that ties merge deterministically
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL EventMerger::Before(UINT a, UINT b) const
+{
+	if (_head[a].timestamp != _head[b].timestamp) return _head[a].timestamp < _head[b].timestamp;
+	return a < b;
+}
+
+void EventMerger::SiftUp(UINT i)
+{
+	UINT source = _heap[i];
+	while (i > 0)
+	{
+		UINT parent = (i - 1) / 2;
+		if (!Before(source, _heap[parent])) break;
+		_heap[i] = _heap[parent];
+		i = parent;
+	}
+	_heap[i] = source;
+}
+
+void EventMerger::SiftDown(UINT i)
+{
+	UINT source = _heap[i];
+	for (;;)
+	{
+		UINT child = 2 * i + 1;
+		if (child >= _cHeap) break;
+		if (child + 1 < _cHeap && Before(_heap[child + 1], _heap[child])) child++;
+		if (!Before(_heap[child], source)) break;
+		_heap[i] = _heap[child];
+		i = child;
+	}
+	_heap[i] = source;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Take the next record of a source as its head
+// The frontier is read before the queue, so an empty queue with that frontier
+// guarantees that every record up to the frontier has already been seen.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL EventMerger::Refill(UINT source)
+{
+	ULONGLONG frontier = _pQueue[source]->Frontier();
+	if (_pQueue[source]->Pop(_head[source])) return true;
+	if (frontier < _stall) _stall = frontier;
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Collect the heads of the sources that do not have one - Call before a series of Next() calls
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void EventMerger::Poll(ULONGLONG now)
+{
+	_now = now;
+	_stall = ~0ULL;
+
+	UINT cSources = _cSources.load(std::memory_order_acquire);
+	BOOL bInHeap[MAX_SOURCES] = {};
+	for (UINT i = 0; i < _cHeap; i++) bInHeap[_heap[i]] = true;
+
+	for (UINT source = 0; source < cSources; source++)
+	{
+		if (bInHeap[source]) continue;
+		if (Refill(source))
+		{
+			_heap[_cHeap] = source;
+			SiftUp(_cHeap++);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Release the oldest record if it can no longer be overtaken
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL EventMerger::Next(EventRecord& er)
+{
+	if (_cHeap == 0) return false;
+
+	UINT source = _heap[0];
+	ULONGLONG timestamp = _head[source].timestamp;
+	if (timestamp > _stall && timestamp + _window > _now) return false;
+
+	er = _head[source];
+	if (timestamp < _lastReleased) _cLate++;
+	else _lastReleased = timestamp;
+
+	// Replace the root with the next record of the same source, or remove it
+	if (!Refill(source))
+	{
+		_heap[0] = _heap[--_cHeap];
+	}
+	if (_cHeap) SiftDown(0);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Statistics for the status display
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT EventMerger::Depth() const
+{
+	UINT depth = _cHeap;
+	UINT cSources = _cSources.load(std::memory_order_acquire);
+	for (UINT i = 0; i < cSources; i++) depth += _pQueue[i]->Depth();
+	return depth;
+}
+
+// Add the records that the queues dropped since the last call to pDropped[MESSAGE_SLOTS + 1],
+// by MessageSlot() then all others
+void EventMerger::TakeDropped(ULONGLONG* pDropped)
+{
+	UINT cSources = _cSources.load(std::memory_order_acquire);
+	for (UINT i = 0; i < cSources; i++)
+	{
+		for (UINT slot = 0; slot <= MESSAGE_SLOTS; slot++) pDropped[slot] += _pQueue[i]->TakeDropped(slot);
+	}
+}
+
+// The records released late since the last call
+ULONGLONG EventMerger::TakeLate()
+{
+	ULONGLONG late = _cLate;
+	_cLate = 0;
+	return late;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "framework.h"
+#include "EventRecord.h"
+#include "EventQueue.h"
+
+#include <atomic>
+#include <mutex>
+
+#define MAX_SOURCES 64
+#define DEFAULT_REORDER_WINDOW 20000    // Microseconds a record may wait for slower sources
+
+// Merges the per-source capture queues into one timestamp ordered stream.
+//
+// The merger keeps the oldest record of every source in a binary heap, so each
+// record costs O(log sources). A record is released when every empty source has
+// promised (through its queue frontier) that nothing older will arrive, or when
+// it has waited longer than the reorder window. Records that arrive after a
+// newer record was already released are passed through at once and counted as late.
+//
+// AddSource may be called from any thread. Poll and Next are called only by the consumer.
+class EventMerger
+{
+private:
+	std::mutex        _mtxAdd;
+	EventQueue*       _pQueue[MAX_SOURCES];
+	std::atomic<UINT> _cSources;
+
+	// Consumer state
+	EventRecord _head[MAX_SOURCES];     // Oldest record taken from each source
+	UINT        _heap[MAX_SOURCES];     // Sources with a head, ordered by head timestamp
+	UINT        _cHeap;
+	ULONGLONG   _window;
+	ULONGLONG   _now;
+	ULONGLONG   _stall;                 // Oldest frontier among the sources without a head
+	ULONGLONG   _lastReleased;
+	ULONGLONG   _cLate;
+
+	BOOL Before(UINT a, UINT b) const;
+	void SiftUp(UINT i);
+	void SiftDown(UINT i);
+	BOOL Refill(UINT source);
+public:
+	EventMerger();
+	~EventMerger();
+	EventMerger(const EventMerger&) = delete;
+	EventMerger& operator=(const EventMerger&) = delete;
+
+	EventQueue* AddSource(UINT cCapacity, UINT* pSource);
+	void SetReorderWindow(ULONGLONG window) { _window = window; }
+	ULONGLONG ReorderWindow() const { return _window; }
+
+	void Poll(ULONGLONG now);
+	BOOL Next(EventRecord& er);
+
+	UINT Sources() const { return _cSources.load(std::memory_order_acquire); }
+	UINT Depth() const;
+	void TakeDropped(ULONGLONG* pDropped);
+	ULONGLONG TakeLate();
+};
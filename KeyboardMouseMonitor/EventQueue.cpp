@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// EventQueue.cpp : Provides a single producer, single consumer lock-free queue
+//                  that carries captured input messages from a capture thread
+//                  to the window thread.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "EventQueue.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+// The capacity is rounded up to a power of two so that slots can be found with a mask
+///////////////////////////////////////////////////////////////////////////////////////////////////
+EventQueue::EventQueue(UINT cCapacity)
+{
+	_cRing = 2;
+	while (_cRing < cCapacity) _cRing <<= 1;
+	_mask = _cRing - 1;
+	_pRing = new EventRecord[_cRing];
+	_head.store(0, std::memory_order_relaxed);
+	_tail.store(0, std::memory_order_relaxed);
+	_frontier.store(0, std::memory_order_relaxed);
+	for (UINT slot = 0; slot <= MESSAGE_SLOTS; slot++) _dropped[slot].store(0, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Destructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+EventQueue::~EventQueue()
+{
+	delete[] _pRing;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Add a record to the queue - Called only by the producer thread
+// Records must be pushed in timestamp order. If the ring is full the record is counted by its
+// message type and dropped.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL EventQueue::Push(const EventRecord& er)
+{
+	UINT head = _head.load(std::memory_order_relaxed);
+	if (head - _tail.load(std::memory_order_acquire) == _cRing)
+	{
+		int slot = MessageSlot(er.message);
+		_dropped[slot < 0 ? MESSAGE_SLOTS : slot].fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	_pRing[head & _mask] = er;
+	_head.store(head + 1, std::memory_order_release);
+	if (er.timestamp > _frontier.load(std::memory_order_relaxed))
+		_frontier.store(er.timestamp, std::memory_order_release);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Promise that nothing older than timestamp will be pushed - Called only by the producer thread
+// An idle source calls this so that it does not hold back the merge of the other sources.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void EventQueue::Heartbeat(ULONGLONG timestamp)
+{
+	if (timestamp > _frontier.load(std::memory_order_relaxed))
+		_frontier.store(timestamp, std::memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Start or stop producing - Called only by the producer thread
+// A closed queue never holds back the merge; opening it again resets the frontier.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void EventQueue::Open(ULONGLONG timestamp)
+{
+	_frontier.store(timestamp, std::memory_order_release);
+}
+
+void EventQueue::Close()
+{
+	_frontier.store(~0ULL, std::memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Remove the oldest record from the queue - Called only by the consumer thread
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL EventQueue::Pop(EventRecord& er)
+{
+	UINT tail = _tail.load(std::memory_order_relaxed);
+	if (tail == _head.load(std::memory_order_acquire)) return false;
+
+	er = _pRing[tail & _mask];
+	_tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Number of records waiting in the queue
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT EventQueue::Depth() const
+{
+	return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The records of a MessageSlot() dropped since the last call, MESSAGE_SLOTS for all others
+// Called only by the consumer thread, the exchange loses no drop counted meanwhile.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ULONGLONG EventQueue::TakeDropped(UINT slot)
+{
+	return slot <= MESSAGE_SLOTS ? _dropped[slot].exchange(0, std::memory_order_relaxed) : 0;
+}
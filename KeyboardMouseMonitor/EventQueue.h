@@ -0,0 +1,42 @@
+#pragma once
+#include "framework.h"
+#include "EventRecord.h"
+#include "MessageFormat.h"
+
+#include <atomic>
+
+#define CACHE_LINE_SIZE 64
+
+// Single producer, single consumer lock-free ring of EventRecords.
+// Each capture source owns one queue; its thread is the only producer
+// and the EventMerger (on the window thread) is the only consumer.
+class EventQueue
+{
+private:
+	EventRecord* _pRing;
+	UINT         _cRing;    // Power of two
+	UINT         _mask;     // _cRing - 1
+
+	alignas(CACHE_LINE_SIZE) std::atomic<UINT>      _head;     // Next slot to write (producer)
+	alignas(CACHE_LINE_SIZE) std::atomic<UINT>      _tail;     // Next slot to read (consumer)
+	alignas(CACHE_LINE_SIZE) std::atomic<ULONGLONG> _frontier; // No record older than this will be pushed
+	std::atomic<ULONGLONG> _dropped[MESSAGE_SLOTS + 1];        // Records lost because the ring was full,
+	                                                           // by MessageSlot() then all others
+public:
+	EventQueue(UINT cCapacity);
+	~EventQueue();
+	EventQueue(const EventQueue&) = delete;
+	EventQueue& operator=(const EventQueue&) = delete;
+
+	// Producer side
+	BOOL Push(const EventRecord& er);
+	void Heartbeat(ULONGLONG timestamp);
+	void Open(ULONGLONG timestamp);
+	void Close();
+
+	// Consumer side
+	BOOL Pop(EventRecord& er);
+	UINT Depth() const;
+	ULONGLONG Frontier() const { return _frontier.load(std::memory_order_acquire); }
+	ULONGLONG TakeDropped(UINT slot);
+};
@@ -0,0 +1,28 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// EventRecord.cpp : Provides the common time base for captured input messages.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "EventRecord.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Return the performance counter converted to microseconds
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ULONGLONG EventTimestamp()
+{
+	static LONGLONG frequency = 0;
+	if (frequency == 0)
+	{
+		LARGE_INTEGER li;
+		QueryPerformanceFrequency(&li);
+		frequency = li.QuadPart;
+	}
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+
+	// Split the conversion so that the multiplication cannot overflow
+	ULONGLONG seconds = counter.QuadPart / frequency;
+	ULONGLONG remainder = counter.QuadPart % frequency;
+	return seconds * 1000000 + remainder * 1000000 / frequency;
+}
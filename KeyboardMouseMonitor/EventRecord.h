@@ -0,0 +1,17 @@
+#pragma once
+#include "framework.h"
+
+// One captured input message, as carried through the capture queues and stored in the history
+struct EventRecord
+{
+	UINT      sequence;   // Assigned when the record is added to the history
+	UINT      message;    // WM_KEYDOWN ... WM_XBUTTONDBLCLK
+	WPARAM    wParam;
+	LPARAM    lParam;
+	ULONGLONG timestamp;  // Microseconds, see EventTimestamp()
+	UINT      source;     // Capture source index (0 is the main window)
+};
+
+// Returns the current time in microseconds from the performance counter.
+// All capture sources stamp their records with this clock so they can be merged.
+ULONGLONG EventTimestamp();
@@ -0,0 +1,243 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// HeatMap.cpp : Provides a tiled, exponentially decaying histogram of where the mouse
+//               is clicked and dragged, and renders it to a bitmap for display.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "HeatMap.h"
+
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define HEAT_SSE2
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+HeatMap::HeatMap()
+{
+	_left = 0;
+	_top = 0;
+	_cTilesX = 0;
+	_cTilesY = 0;
+	_ppTile = NULL;
+	_cTiles = 0;
+	_cRejected = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Destructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+HeatMap::~HeatMap()
+{
+	Free();
+}
+
+void HeatMap::Free()
+{
+	Clear();
+	delete[] _ppTile;
+	_ppTile = NULL;
+	_cTilesX = 0;
+	_cTilesY = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Initializer
+// Sizes the tile grid to cover the given area, normally the virtual screen
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL HeatMap::Init(int left, int top, int width, int height)
+{
+	Free();
+	if (width <= 0 || height <= 0) return false;
+
+	_left = left;
+	_top = top;
+	_cTilesX = (width + HEAT_TILE_SIZE - 1) / HEAT_TILE_SIZE;
+	_cTilesY = (height + HEAT_TILE_SIZE - 1) / HEAT_TILE_SIZE;
+	_ppTile = new Tile*[_cTilesX * _cTilesY]();
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Forget everything recorded
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void HeatMap::Clear()
+{
+	if (_ppTile)
+	{
+		for (UINT i = 0; i < _cTilesX * _cTilesY; i++)
+		{
+			delete _ppTile[i];
+			_ppTile[i] = NULL;
+		}
+	}
+	_cTiles = 0;
+	_cRejected = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Accumulate a position - Positions outside the area are ignored
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void HeatMap::Add(int x, int y, float weight)
+{
+	UINT px = (UINT)(x - _left);
+	UINT py = (UINT)(y - _top);
+	UINT tx = px / HEAT_TILE_SIZE;
+	UINT ty = py / HEAT_TILE_SIZE;
+	if (tx >= _cTilesX || ty >= _cTilesY) return;  // Also catches negative offsets
+
+	Tile*& pTile = _ppTile[ty * _cTilesX + tx];
+	if (pTile == NULL)
+	{
+		if (_cTiles == MAX_HEAT_TILES)
+		{
+			_cRejected++;
+			return;
+		}
+		pTile = new Tile();
+		_cTiles++;
+	}
+
+	UINT cx = (px % HEAT_TILE_SIZE) / HEAT_CELL_SIZE;
+	UINT cy = (py % HEAT_TILE_SIZE) / HEAT_CELL_SIZE;
+	pTile->cell[cy * HEAT_TILE_CELLS + cx] += weight;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Accumulate a recorded mouse message - Returns false for messages that carry no click or drag
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL HeatMap::AddMessage(UINT message, int x, int y)
+{
+	switch (message)
+	{
+	case WM_MOUSEMOVE:
+		Add(x, y, HEAT_MOVE_WEIGHT);
+		return true;
+	case WM_LBUTTONDOWN:
+	case WM_LBUTTONDBLCLK:
+	case WM_RBUTTONDOWN:
+	case WM_RBUTTONDBLCLK:
+	case WM_MBUTTONDOWN:
+	case WM_MBUTTONDBLCLK:
+	case WM_XBUTTONDOWN:
+	case WM_XBUTTONDBLCLK:
+		Add(x, y, HEAT_CLICK_WEIGHT);
+		return true;
+	default:
+		return false;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Multiply every cell by factor, and free the tiles whose hottest cell has gone cold
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void HeatMap::Decay(float factor)
+{
+	const UINT cCells = HEAT_TILE_CELLS * HEAT_TILE_CELLS;
+
+	for (UINT i = 0; i < _cTilesX * _cTilesY; i++)
+	{
+		Tile* pTile = _ppTile[i];
+		if (pTile == NULL) continue;
+
+		float hottest;
+#ifdef HEAT_SSE2
+		__m128 vFactor = _mm_set1_ps(factor);
+		__m128 vMax = _mm_setzero_ps();
+		for (UINT c = 0; c < cCells; c += 4)
+		{
+			__m128 v = _mm_mul_ps(_mm_load_ps(&pTile->cell[c]), vFactor);
+			_mm_store_ps(&pTile->cell[c], v);
+			vMax = _mm_max_ps(vMax, v);
+		}
+		vMax = _mm_max_ps(vMax, _mm_shuffle_ps(vMax, vMax, _MM_SHUFFLE(1, 0, 3, 2)));
+		vMax = _mm_max_ps(vMax, _mm_shuffle_ps(vMax, vMax, _MM_SHUFFLE(2, 3, 0, 1)));
+		hottest = _mm_cvtss_f32(vMax);
+#else
+		hottest = 0.0f;
+		for (UINT c = 0; c < cCells; c++)
+		{
+			pTile->cell[c] *= factor;
+			if (pTile->cell[c] > hottest) hottest = pTile->cell[c];
+		}
+#endif
+		if (hottest < HEAT_COLD)
+		{
+			delete pTile;
+			_ppTile[i] = NULL;
+			_cTiles--;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The hottest cell, used to scale the colors
+///////////////////////////////////////////////////////////////////////////////////////////////////
+float HeatMap::Max() const
+{
+	float hottest = 0.0f;
+	for (UINT i = 0; i < _cTilesX * _cTilesY; i++)
+	{
+		const Tile* pTile = _ppTile[i];
+		if (pTile == NULL) continue;
+		for (UINT c = 0; c < HEAT_TILE_CELLS * HEAT_TILE_CELLS; c++)
+		{
+			if (pTile->cell[c] > hottest) hottest = pTile->cell[c];
+		}
+	}
+	return hottest;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Render one 0x00RRGGBB pixel per cell, CellsX() by CellsY(), top row first
+// The scale is logarithmic so that a few hot spots do not wash out the drags.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void HeatMap::Render(DWORD* pPixels) const
+{
+	// Black, blue, red, yellow, white
+	static const DWORD ramp[] = { 0x000000, 0x0000C0, 0xC00000, 0xFFFF00, 0xFFFFFF };
+	const UINT cSteps = ARRAYSIZE(ramp) - 1;
+
+	UINT cxCells = CellsX();
+	float hottest = Max();
+	float scale = hottest > 0.0f ? 1.0f / log1pf(hottest) : 0.0f;
+
+	for (UINT ty = 0; ty < _cTilesY; ty++)
+	{
+		for (UINT tx = 0; tx < _cTilesX; tx++)
+		{
+			const Tile* pTile = _ppTile[ty * _cTilesX + tx];
+			for (UINT cy = 0; cy < HEAT_TILE_CELLS; cy++)
+			{
+				DWORD* pRow = pPixels + (ty * HEAT_TILE_CELLS + cy) * cxCells + tx * HEAT_TILE_CELLS;
+				for (UINT cx = 0; cx < HEAT_TILE_CELLS; cx++)
+				{
+					float level = pTile ? log1pf(pTile->cell[cy * HEAT_TILE_CELLS + cx]) * scale : 0.0f;
+					if (level <= 0.0f)
+					{
+						pRow[cx] = ramp[0];
+						continue;
+					}
+
+					// Interpolate between the two nearest colors of the ramp
+					float position = (level < 1.0f ? level : 1.0f) * cSteps;
+					UINT step = (UINT)position;
+					if (step >= cSteps) step = cSteps - 1;
+					float f = position - step;
+					DWORD c0 = ramp[step], c1 = ramp[step + 1];
+					DWORD color = 0;
+					for (UINT shift = 0; shift < 24; shift += 8)
+					{
+						float a = (float)((c0 >> shift) & 0xFF);
+						float b = (float)((c1 >> shift) & 0xFF);
+						color |= (DWORD)(a + (b - a) * f) << shift;
+					}
+					pRow[cx] = color;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "framework.h"
+
+#define HEAT_CELL_SIZE 4                                    // Pixels per cell side
+#define HEAT_TILE_CELLS 16                                  // Cells per tile side
+#define HEAT_TILE_SIZE (HEAT_CELL_SIZE * HEAT_TILE_CELLS)   // Pixels per tile side
+#define MAX_HEAT_TILES 4096                                 // 1 KB each, bounds the memory to 4 MB
+#define HEAT_COLD 0.01f                                     // Tiles that decay below this are freed
+
+// Weights of the events that are accumulated
+#define HEAT_CLICK_WEIGHT 16.0f
+#define HEAT_MOVE_WEIGHT 1.0f
+
+// A decaying 2D histogram of mouse positions over the virtual screen.
+//
+// The screen is divided into tiles that are allocated on first use, so memory grows only
+// with the area that is actually clicked or dragged over, and is bounded by MAX_HEAT_TILES.
+// Adding a position is one index calculation and one addition. Decay multiplies whole
+// tiles with SSE and frees the tiles that have gone cold.
+class HeatMap
+{
+private:
+	struct alignas(16) Tile
+	{
+		float cell[HEAT_TILE_CELLS * HEAT_TILE_CELLS];
+	};
+
+	int    _left;
+	int    _top;
+	UINT   _cTilesX;
+	UINT   _cTilesY;
+	Tile** _ppTile;         // _cTilesX * _cTilesY, NULL where nothing has been recorded
+	UINT   _cTiles;         // Allocated tiles
+	UINT   _cRejected;      // Positions lost because MAX_HEAT_TILES was reached
+
+	void Free();
+public:
+	HeatMap();
+	~HeatMap();
+	HeatMap(const HeatMap&) = delete;
+	HeatMap& operator=(const HeatMap&) = delete;
+
+	BOOL Init(int left, int top, int width, int height);
+	void Clear();
+	void Add(int x, int y, float weight);
+	BOOL AddMessage(UINT message, int x, int y);
+	void Decay(float factor);
+	float Max() const;
+	void Render(DWORD* pPixels) const;
+
+	UINT CellsX() const { return _cTilesX * HEAT_TILE_CELLS; }
+	UINT CellsY() const { return _cTilesY * HEAT_TILE_CELLS; }
+	UINT Tiles() const { return _cTiles; }
+	UINT Rejected() const { return _cRejected; }
+};
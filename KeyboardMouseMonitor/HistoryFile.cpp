@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// HistoryFile.cpp : Provides the snapshot files that restore the history of the last session.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "HistoryFile.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+HistoryFile::HistoryFile()
+{
+	ZeroMemory(_szPath, sizeof(_szPath));
+	_next = 0;
+	_generation = 0;
+	_lastSaved = 0;
+	_bBusy = false;
+	_bFailed = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Destructor - Waits for a save in progress
+///////////////////////////////////////////////////////////////////////////////////////////////////
+HistoryFile::~HistoryFile()
+{
+	Wait();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Name the files <base>.1.kmc and <base>.2.kmc
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL HistoryFile::Init(const TCHAR* pszBase)
+{
+	for (UINT i = 0; i < HISTORY_FILES; i++)
+	{
+		if (FAILED(StringCchPrintf(_szPath[i], MAX_PATH, _T("%s.%u.kmc"), pszBase, i + 1))) return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Map the newest complete file into the empty history - Returns the number of records restored
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT HistoryFile::Restore(EventHistory* pHistory)
+{
+	std::shared_ptr<CaptureFile> pNewest;
+	for (UINT i = 0; i < HISTORY_FILES; i++)
+	{
+		std::shared_ptr<CaptureFile> pFile = std::make_shared<CaptureFile>();
+		if (!pFile->Open(_szPath[i]) || !pFile->isComplete()) continue;
+
+		// Generations wrap around; the newer of two is less than half the range ahead
+		if (!pNewest || pFile->Generation() - pNewest->Generation() < 0x80000000)
+		{
+			pNewest = pFile;
+			_next = (i + 1) % HISTORY_FILES;
+		}
+	}
+	if (!pNewest) return 0;
+
+	_generation = pNewest->Generation();
+	UINT cRestored = pHistory->Restore(pNewest);
+	_lastSaved = pHistory->Last();
+	return cRestored;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Save the history if it changed since the last save - Returns false if the last save failed
+// or, without bWait, if one is still in progress. With bWait, returns when the save is complete.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL HistoryFile::Save(EventHistory* pHistory, BOOL bWait)
+{
+	if (_szPath[0][0] == 0 || (_bBusy && !bWait)) return false;
+	Wait();
+	if (_bFailed) _lastSaved = 0;
+
+	BOOL bOK = !_bFailed;
+	if (pHistory->Last() != _lastSaved)
+	{
+		// Not releasable, because it is read on the save thread
+		_lastSaved = pHistory->Last();
+		_bBusy = true;
+		_bFailed = false;
+		_thread = std::thread(Write, this, pHistory->Snapshot(false), _generation + 1);
+		if (bWait)
+		{
+			Wait();
+			bOK = !_bFailed;
+		}
+	}
+	return bOK;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Wait for a save in progress
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void HistoryFile::Wait()
+{
+	if (_thread.joinable()) _thread.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The save thread - Writes the newest records of the snapshot
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void HistoryFile::Write(HistoryFile* pThis, HistorySnapshot snapshot, DWORD generation)
+{
+	UINT first = snapshot.First();
+	if (snapshot.Last() - first >= MAX_SAVED_HISTORY) first = snapshot.Last() - MAX_SAVED_HISTORY + 1;
+
+	CaptureWriter writer;
+	BOOL bOK = writer.Open(pThis->_szPath[pThis->_next], generation);
+	EventRecord er;
+	for (UINT sequence = first; bOK && sequence && sequence <= snapshot.Last(); sequence++)
+	{
+		bOK = snapshot.Get(sequence, &er) && writer.Write(er);
+	}
+	if (!writer.Close()) bOK = false;
+
+	if (bOK) pThis->_generation = generation;
+	pThis->_bFailed = !bOK;
+	pThis->_bBusy = false;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "framework.h"
+#include "EventHistory.h"
+
+#include <atomic>
+#include <thread>
+
+#define HISTORY_FILES 2                         // Used in turn
+#define MAX_SAVED_HISTORY (HISTORY_CHUNK * MAX_HISTORY_CHUNKS)
+
+// Keeps the history across sessions in snapshot files, which are capture files.
+//
+// Restoring maps the newest complete file into the history, where its records are read in
+// place, so the time it takes does not depend on the length of the history. Saving writes the
+// newest MAX_SAVED_HISTORY records of a snapshot of the history on a background thread. The
+// saves of a session all go to the file that was not restored, which is never the one mapped,
+// and the file restored stays intact until a save has completed.
+class HistoryFile
+{
+private:
+	TCHAR             _szPath[HISTORY_FILES][MAX_PATH];
+	UINT              _next;                // File the saves write
+	DWORD             _generation;          // Of the newest complete file
+	UINT              _lastSaved;           // Sequence number of the newest record saved
+	std::thread       _thread;
+	std::atomic<bool> _bBusy;
+	std::atomic<bool> _bFailed;
+
+	static void Write(HistoryFile* pThis, HistorySnapshot snapshot, DWORD generation);
+public:
+	HistoryFile();
+	~HistoryFile();
+	HistoryFile(const HistoryFile&) = delete;
+	HistoryFile& operator=(const HistoryFile&) = delete;
+
+	BOOL Init(const TCHAR* pszBase);
+	UINT Restore(EventHistory* pHistory);
+	BOOL Save(EventHistory* pHistory, BOOL bWait);
+	void Wait();
+	BOOL isBusy() const { return _bBusy; }
+};
@@ -0,0 +1,181 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// KeyNames.cpp : Provides the names of scan codes and virtual key codes.
+//
+//                The sparse lists below are turned into direct-index tables at compile time,
+//                scan codes indexed by the low byte with bit 8 set for the 0xE0 prefix (as
+//                the pattern detector folds them), virtual keys by the code itself. A lookup
+//                is one bounds check and one load. Duplicate entries fail the build.
+//
+//                The names follow scan code set 1 on a US keyboard, as Windows reports it in
+//                the lParam of a keyboard message. Pause arrives as 0x45 and Num Lock as
+//                0xE045 there, the reverse of the raw make codes.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "KeyNames.h"
+
+#include <array>
+
+#define NAME(s) { _T(s), sizeof(s) - 1 }
+#define SCANCODE_INDEX(scanCode) (((scanCode) & 0xFF) | (((scanCode) & 0xFF00) ? 0x100 : 0))
+
+struct KeyCodeName
+{
+	WORD    code;
+	KeyName name;
+};
+
+static constexpr KeyCodeName scanCodeList[] =
+{
+	{ 0x0001, NAME("Esc") },           { 0x0002, NAME("1") },             { 0x0003, NAME("2") },
+	{ 0x0004, NAME("3") },             { 0x0005, NAME("4") },             { 0x0006, NAME("5") },
+	{ 0x0007, NAME("6") },             { 0x0008, NAME("7") },             { 0x0009, NAME("8") },
+	{ 0x000A, NAME("9") },             { 0x000B, NAME("0") },             { 0x000C, NAME("-") },
+	{ 0x000D, NAME("=") },             { 0x000E, NAME("Backspace") },     { 0x000F, NAME("Tab") },
+	{ 0x0010, NAME("Q") },             { 0x0011, NAME("W") },             { 0x0012, NAME("E") },
+	{ 0x0013, NAME("R") },             { 0x0014, NAME("T") },             { 0x0015, NAME("Y") },
+	{ 0x0016, NAME("U") },             { 0x0017, NAME("I") },             { 0x0018, NAME("O") },
+	{ 0x0019, NAME("P") },             { 0x001A, NAME("[") },             { 0x001B, NAME("]") },
+	{ 0x001C, NAME("Enter") },         { 0x001D, NAME("Left Ctrl") },     { 0x001E, NAME("A") },
+	{ 0x001F, NAME("S") },             { 0x0020, NAME("D") },             { 0x0021, NAME("F") },
+	{ 0x0022, NAME("G") },             { 0x0023, NAME("H") },             { 0x0024, NAME("J") },
+	{ 0x0025, NAME("K") },             { 0x0026, NAME("L") },             { 0x0027, NAME(";") },
+	{ 0x0028, NAME("'") },             { 0x0029, NAME("`") },             { 0x002A, NAME("Left Shift") },
+	{ 0x002B, NAME("\\") },            { 0x002C, NAME("Z") },             { 0x002D, NAME("X") },
+	{ 0x002E, NAME("C") },             { 0x002F, NAME("V") },             { 0x0030, NAME("B") },
+	{ 0x0031, NAME("N") },             { 0x0032, NAME("M") },             { 0x0033, NAME(",") },
+	{ 0x0034, NAME(".") },             { 0x0035, NAME("/") },             { 0x0036, NAME("Right Shift") },
+	{ 0x0037, NAME("Num *") },         { 0x0038, NAME("Left Alt") },      { 0x0039, NAME("Space") },
+	{ 0x003A, NAME("Caps Lock") },     { 0x003B, NAME("F1") },            { 0x003C, NAME("F2") },
+	{ 0x003D, NAME("F3") },            { 0x003E, NAME("F4") },            { 0x003F, NAME("F5") },
+	{ 0x0040, NAME("F6") },            { 0x0041, NAME("F7") },            { 0x0042, NAME("F8") },
+	{ 0x0043, NAME("F9") },            { 0x0044, NAME("F10") },           { 0x0045, NAME("Pause") },
+	{ 0x0046, NAME("Scroll Lock") },   { 0x0047, NAME("Num 7") },         { 0x0048, NAME("Num 8") },
+	{ 0x0049, NAME("Num 9") },         { 0x004A, NAME("Num -") },         { 0x004B, NAME("Num 4") },
+	{ 0x004C, NAME("Num 5") },         { 0x004D, NAME("Num 6") },         { 0x004E, NAME("Num +") },
+	{ 0x004F, NAME("Num 1") },         { 0x0050, NAME("Num 2") },         { 0x0051, NAME("Num 3") },
+	{ 0x0052, NAME("Num 0") },         { 0x0053, NAME("Num .") },         { 0x0054, NAME("Sys Req") },
+	{ 0x0056, NAME("\\ (102nd)") },    { 0x0057, NAME("F11") },           { 0x0058, NAME("F12") },
+	{ 0x0059, NAME("Num =") },         { 0x0064, NAME("F13") },           { 0x0065, NAME("F14") },
+	{ 0x0066, NAME("F15") },           { 0x0067, NAME("F16") },           { 0x0068, NAME("F17") },
+	{ 0x0069, NAME("F18") },           { 0x006A, NAME("F19") },           { 0x006B, NAME("F20") },
+	{ 0x006C, NAME("F21") },           { 0x006D, NAME("F22") },           { 0x006E, NAME("F23") },
+	{ 0x0070, NAME("Kana") },          { 0x0073, NAME("Ro") },            { 0x0076, NAME("F24") },
+	{ 0x0079, NAME("Convert") },       { 0x007B, NAME("No Convert") },    { 0x007D, NAME("Yen") },
+	{ 0x007E, NAME("Num ,") },
+
+	{ 0xE010, NAME("Previous Track") },{ 0xE019, NAME("Next Track") },    { 0xE01C, NAME("Num Enter") },
+	{ 0xE01D, NAME("Right Ctrl") },    { 0xE020, NAME("Mute") },          { 0xE021, NAME("Calculator") },
+	{ 0xE022, NAME("Play/Pause") },    { 0xE024, NAME("Stop") },          { 0xE02E, NAME("Volume Down") },
+	{ 0xE030, NAME("Volume Up") },     { 0xE032, NAME("Browser Home") },  { 0xE035, NAME("Num /") },
+	{ 0xE037, NAME("Print Screen") },  { 0xE038, NAME("Right Alt") },     { 0xE045, NAME("Num Lock") },
+	{ 0xE046, NAME("Break") },         { 0xE047, NAME("Home") },          { 0xE048, NAME("Up") },
+	{ 0xE049, NAME("Page Up") },       { 0xE04B, NAME("Left") },          { 0xE04D, NAME("Right") },
+	{ 0xE04F, NAME("End") },           { 0xE050, NAME("Down") },          { 0xE051, NAME("Page Down") },
+	{ 0xE052, NAME("Insert") },        { 0xE053, NAME("Delete") },        { 0xE05B, NAME("Left Win") },
+	{ 0xE05C, NAME("Right Win") },     { 0xE05D, NAME("Menu") },          { 0xE05E, NAME("Power") },
+	{ 0xE05F, NAME("Sleep") },         { 0xE063, NAME("Wake") },          { 0xE065, NAME("Browser Search") },
+	{ 0xE066, NAME("Favorites") },     { 0xE067, NAME("Refresh") },       { 0xE068, NAME("Browser Stop") },
+	{ 0xE069, NAME("Forward") },       { 0xE06A, NAME("Back") },          { 0xE06B, NAME("My Computer") },
+	{ 0xE06C, NAME("Mail") },          { 0xE06D, NAME("Media Select") }
+};
+
+static constexpr KeyCodeName virtualKeyList[] =
+{
+	{ 0x01, NAME("VK_LBUTTON") },      { 0x02, NAME("VK_RBUTTON") },      { 0x03, NAME("VK_CANCEL") },
+	{ 0x04, NAME("VK_MBUTTON") },      { 0x05, NAME("VK_XBUTTON1") },     { 0x06, NAME("VK_XBUTTON2") },
+	{ 0x08, NAME("VK_BACK") },         { 0x09, NAME("VK_TAB") },          { 0x0C, NAME("VK_CLEAR") },
+	{ 0x0D, NAME("VK_RETURN") },       { 0x10, NAME("VK_SHIFT") },        { 0x11, NAME("VK_CONTROL") },
+	{ 0x12, NAME("VK_MENU") },         { 0x13, NAME("VK_PAUSE") },        { 0x14, NAME("VK_CAPITAL") },
+	{ 0x15, NAME("VK_KANA") },         { 0x16, NAME("VK_IME_ON") },       { 0x17, NAME("VK_JUNJA") },
+	{ 0x18, NAME("VK_FINAL") },        { 0x19, NAME("VK_KANJI") },        { 0x1A, NAME("VK_IME_OFF") },
+	{ 0x1B, NAME("VK_ESCAPE") },       { 0x1C, NAME("VK_CONVERT") },      { 0x1D, NAME("VK_NONCONVERT") },
+	{ 0x1E, NAME("VK_ACCEPT") },       { 0x1F, NAME("VK_MODECHANGE") },   { 0x20, NAME("VK_SPACE") },
+	{ 0x21, NAME("VK_PRIOR") },        { 0x22, NAME("VK_NEXT") },         { 0x23, NAME("VK_END") },
+	{ 0x24, NAME("VK_HOME") },         { 0x25, NAME("VK_LEFT") },         { 0x26, NAME("VK_UP") },
+	{ 0x27, NAME("VK_RIGHT") },        { 0x28, NAME("VK_DOWN") },         { 0x29, NAME("VK_SELECT") },
+	{ 0x2A, NAME("VK_PRINT") },        { 0x2B, NAME("VK_EXECUTE") },      { 0x2C, NAME("VK_SNAPSHOT") },
+	{ 0x2D, NAME("VK_INSERT") },       { 0x2E, NAME("VK_DELETE") },       { 0x2F, NAME("VK_HELP") },
+	{ 0x30, NAME("'0'") },             { 0x31, NAME("'1'") },             { 0x32, NAME("'2'") },
+	{ 0x33, NAME("'3'") },             { 0x34, NAME("'4'") },             { 0x35, NAME("'5'") },
+	{ 0x36, NAME("'6'") },             { 0x37, NAME("'7'") },             { 0x38, NAME("'8'") },
+	{ 0x39, NAME("'9'") },             { 0x41, NAME("'A'") },             { 0x42, NAME("'B'") },
+	{ 0x43, NAME("'C'") },             { 0x44, NAME("'D'") },             { 0x45, NAME("'E'") },
+	{ 0x46, NAME("'F'") },             { 0x47, NAME("'G'") },             { 0x48, NAME("'H'") },
+	{ 0x49, NAME("'I'") },             { 0x4A, NAME("'J'") },             { 0x4B, NAME("'K'") },
+	{ 0x4C, NAME("'L'") },             { 0x4D, NAME("'M'") },             { 0x4E, NAME("'N'") },
+	{ 0x4F, NAME("'O'") },             { 0x50, NAME("'P'") },             { 0x51, NAME("'Q'") },
+	{ 0x52, NAME("'R'") },             { 0x53, NAME("'S'") },             { 0x54, NAME("'T'") },
+	{ 0x55, NAME("'U'") },             { 0x56, NAME("'V'") },             { 0x57, NAME("'W'") },
+	{ 0x58, NAME("'X'") },             { 0x59, NAME("'Y'") },             { 0x5A, NAME("'Z'") },
+	{ 0x5B, NAME("VK_LWIN") },         { 0x5C, NAME("VK_RWIN") },         { 0x5D, NAME("VK_APPS") },
+	{ 0x5F, NAME("VK_SLEEP") },        { 0x60, NAME("VK_NUMPAD0") },      { 0x61, NAME("VK_NUMPAD1") },
+	{ 0x62, NAME("VK_NUMPAD2") },      { 0x63, NAME("VK_NUMPAD3") },      { 0x64, NAME("VK_NUMPAD4") },
+	{ 0x65, NAME("VK_NUMPAD5") },      { 0x66, NAME("VK_NUMPAD6") },      { 0x67, NAME("VK_NUMPAD7") },
+	{ 0x68, NAME("VK_NUMPAD8") },      { 0x69, NAME("VK_NUMPAD9") },      { 0x6A, NAME("VK_MULTIPLY") },
+	{ 0x6B, NAME("VK_ADD") },          { 0x6C, NAME("VK_SEPARATOR") },    { 0x6D, NAME("VK_SUBTRACT") },
+	{ 0x6E, NAME("VK_DECIMAL") },      { 0x6F, NAME("VK_DIVIDE") },       { 0x70, NAME("VK_F1") },
+	{ 0x71, NAME("VK_F2") },           { 0x72, NAME("VK_F3") },           { 0x73, NAME("VK_F4") },
+	{ 0x74, NAME("VK_F5") },           { 0x75, NAME("VK_F6") },           { 0x76, NAME("VK_F7") },
+	{ 0x77, NAME("VK_F8") },           { 0x78, NAME("VK_F9") },           { 0x79, NAME("VK_F10") },
+	{ 0x7A, NAME("VK_F11") },          { 0x7B, NAME("VK_F12") },          { 0x7C, NAME("VK_F13") },
+	{ 0x7D, NAME("VK_F14") },          { 0x7E, NAME("VK_F15") },          { 0x7F, NAME("VK_F16") },
+	{ 0x80, NAME("VK_F17") },          { 0x81, NAME("VK_F18") },          { 0x82, NAME("VK_F19") },
+	{ 0x83, NAME("VK_F20") },          { 0x84, NAME("VK_F21") },          { 0x85, NAME("VK_F22") },
+	{ 0x86, NAME("VK_F23") },          { 0x87, NAME("VK_F24") },          { 0x90, NAME("VK_NUMLOCK") },
+	{ 0x91, NAME("VK_SCROLL") },       { 0xA0, NAME("VK_LSHIFT") },       { 0xA1, NAME("VK_RSHIFT") },
+	{ 0xA2, NAME("VK_LCONTROL") },     { 0xA3, NAME("VK_RCONTROL") },     { 0xA4, NAME("VK_LMENU") },
+	{ 0xA5, NAME("VK_RMENU") },        { 0xA6, NAME("VK_BROWSER_BACK") }, { 0xA7, NAME("VK_BROWSER_FORWARD") },
+	{ 0xA8, NAME("VK_BROWSER_REFRESH") }, { 0xA9, NAME("VK_BROWSER_STOP") }, { 0xAA, NAME("VK_BROWSER_SEARCH") },
+	{ 0xAB, NAME("VK_BROWSER_FAVORITES") }, { 0xAC, NAME("VK_BROWSER_HOME") }, { 0xAD, NAME("VK_VOLUME_MUTE") },
+	{ 0xAE, NAME("VK_VOLUME_DOWN") },  { 0xAF, NAME("VK_VOLUME_UP") },    { 0xB0, NAME("VK_MEDIA_NEXT_TRACK") },
+	{ 0xB1, NAME("VK_MEDIA_PREV_TRACK") }, { 0xB2, NAME("VK_MEDIA_STOP") }, { 0xB3, NAME("VK_MEDIA_PLAY_PAUSE") },
+	{ 0xB4, NAME("VK_LAUNCH_MAIL") },  { 0xB5, NAME("VK_LAUNCH_MEDIA_SELECT") }, { 0xB6, NAME("VK_LAUNCH_APP1") },
+	{ 0xB7, NAME("VK_LAUNCH_APP2") },  { 0xBA, NAME("VK_OEM_1") },        { 0xBB, NAME("VK_OEM_PLUS") },
+	{ 0xBC, NAME("VK_OEM_COMMA") },    { 0xBD, NAME("VK_OEM_MINUS") },    { 0xBE, NAME("VK_OEM_PERIOD") },
+	{ 0xBF, NAME("VK_OEM_2") },        { 0xC0, NAME("VK_OEM_3") },        { 0xDB, NAME("VK_OEM_4") },
+	{ 0xDC, NAME("VK_OEM_5") },        { 0xDD, NAME("VK_OEM_6") },        { 0xDE, NAME("VK_OEM_7") },
+	{ 0xDF, NAME("VK_OEM_8") },        { 0xE2, NAME("VK_OEM_102") },      { 0xE5, NAME("VK_PROCESSKEY") },
+	{ 0xE7, NAME("VK_PACKET") },       { 0xF6, NAME("VK_ATTN") },         { 0xF7, NAME("VK_CRSEL") },
+	{ 0xF8, NAME("VK_EXSEL") },        { 0xF9, NAME("VK_EREOF") },        { 0xFA, NAME("VK_PLAY") },
+	{ 0xFB, NAME("VK_ZOOM") },         { 0xFD, NAME("VK_PA1") },          { 0xFE, NAME("VK_OEM_CLEAR") }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Spread a sparse list over a direct-index table at compile time
+///////////////////////////////////////////////////////////////////////////////////////////////////
+template <size_t SIZE, size_t N>
+static constexpr std::array<KeyName, SIZE> BuildTable(const KeyCodeName (&list)[N], BOOL bScanCode)
+{
+	std::array<KeyName, SIZE> table = {};
+	for (size_t i = 0; i < SIZE; i++) table[i] = { _T(""), 0 };
+	for (size_t i = 0; i < N; i++)
+	{
+		size_t index = bScanCode ? SCANCODE_INDEX(list[i].code) : list[i].code;
+		if (index >= SIZE || table[index].cchName) throw "Key code out of range or listed twice";
+		table[index] = list[i].name;
+	}
+	return table;
+}
+
+static constexpr std::array<KeyName, 512> scanCodeTable = BuildTable<512>(scanCodeList, true);
+static constexpr std::array<KeyName, 256> virtualKeyTable = BuildTable<256>(virtualKeyList, false);
+static constexpr KeyName noName = { _T(""), 0 };
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The name of an extended scan code
+///////////////////////////////////////////////////////////////////////////////////////////////////
+const KeyName& ScanCodeName(WORD scanCode)
+{
+	BYTE prefix = HIBYTE(scanCode);
+	if (prefix != 0 && prefix != 0xE0) return noName;
+	return scanCodeTable[SCANCODE_INDEX(scanCode)];
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The name of a virtual key code
+///////////////////////////////////////////////////////////////////////////////////////////////////
+const KeyName& VirtualKeyName(UINT vk)
+{
+	return vk < 256 ? virtualKeyTable[vk] : noName;
+}
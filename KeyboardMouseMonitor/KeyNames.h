@@ -0,0 +1,23 @@
+#pragma once
+#include "framework.h"
+
+// A key name and its length
+struct KeyName
+{
+	const TCHAR* pszName;
+	UINT         cchName;
+};
+
+// The name of a scan code as GetExtendedStatus() shows it, with 0xE0 in the high byte for
+// extended keys (0x001C Enter, 0xE01C Num Enter) - An empty name if the code has none
+const KeyName& ScanCodeName(WORD scanCode);
+
+// The name of a virtual key code, such as VK_LEFT or 'A' - An empty name if the code has none
+const KeyName& VirtualKeyName(UINT vk);
+
+// The extended scan code of a keyboard message, as GetExtendedStatus() shows it
+inline WORD ExtendedScanCode(LPARAM lParam)
+{
+	WORD scanCode = LOBYTE(HIWORD(lParam));
+	return HIWORD(lParam) & KF_EXTENDED ? MAKEWORD(scanCode, 0xE0) : scanCode;
+}
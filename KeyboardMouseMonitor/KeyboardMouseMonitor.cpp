@@ -9,6 +9,28 @@
 //
 // Has support for changing the font and color, as well as saving to the registry.
 //
+// Has support for merging every keyboard and mouse, through Raw Input, with the main window
+// into one timestamp ordered stream, from lock-free queues per capture source.
+//
+// Has support for freezing the display to inspect the history while capture continues.
+//
+// Has support for shedding input in stages under overload, with exact counts of what was shed.
+//
+// Has support for reconstructing the typed text and finding text in it.
+//
+// Has support for naming the keys by scan code and virtual key code.
+//
+// Has support for showing each keystroke as one row, joining its key down, characters
+// and key up, with the raw messages a menu toggle away.
+//
+// Has support for saving the history to a capture file for KeyboardMouseAnalyzer.
+//
+// Has support for restoring the history of the last session, from snapshot files next to
+// the executable that are saved at intervals and on exit, and mapped rather than read.
+//
+// Has support for alerting on key patterns listed in KeyboardMouseMonitor.rules,
+// a text file next to the executable (see PatternDetector.h for the syntax).
+//
 // Microsoft Visual Studio Community Edition 64 bit, version 17.9.6
 //
 // Alex Sokolek, Version 1.0.0.1, Copyright (c) March 26, 2024
@@ -23,8 +45,40 @@
 #include "KeyboardMouseMonitor.h"
 
 #include "ApplicationRegistry.h"                // Application Registry Settings class
+#include "EventMerger.h"                        // Merges the capture sources by timestamp
+#include "RawInputSource.h"                     // Captures every keyboard and mouse
+#include "LoadGenerator.h"                      // Synthetic input for stress tests
+#include "PatternDetector.h"                    // Alerts on key patterns
+#include "HeatMap.h"                            // Where the mouse is clicked and dragged
+#include "Trajectory.h"                         // Mouse speed, acceleration and polling rate
+#include "EventHistory.h"                       // Every recorded message
+#include "DisplayRows.h"                        // The rows on display, with autorepeat folding and keystrokes
+#include "OverloadController.h"                 // Sheds input in stages under overload
+#include "TypedText.h"                          // The text reconstructed from the typed characters
+#include "MessageFormat.h"                      // The message table and the row formatters
+#include "CaptureFile.h"                        // The history saved for offline analysis
+#include "HistoryFile.h"                        // The history kept across sessions
 
 #define MAX_LOADSTRING 100
+#define WINDOW_QUEUE_CAPACITY 256               // The window queue is drained as soon as it is filled
+#define IDT_MERGE 1                             // Timer that drains the other capture sources
+#define MERGE_INTERVAL 10                       // Milliseconds between drains of the other sources
+#define MAX_DRAIN 16384                         // Most messages merged per drain, keeps the window responsive
+#define MAX_ALERT_LEN 150
+#define MAX_MATCHES 8                           // Most pattern matches reported per key press
+#define KEY_SOURCE 0                            // The capture source whose keys are matched and typed
+#define IDT_HEATMAP 2                           // Timer that decays the heat map
+#define HEAT_DECAY_INTERVAL 250                 // Milliseconds between decay steps
+#define HEAT_DECAY_FACTOR 0.982821f             // Half-life of 10 seconds at 4 steps per second
+#define IDT_TRAJECTORY 3                        // Timer that updates the trajectory statistics
+#define TRAJECTORY_INTERVAL 500                 // Milliseconds between updates
+#define MAX_STATUS_LEN 150
+#define MAX_REBUILD 65536                       // Most history replayed when the rows are rebuilt
+#define ROWS_TOP 10                             // Client y of the first row
+#define MAX_OVERLOAD_LEN 600
+#define MAX_TYPED_TAIL 100                      // Most typed characters shown before the cursor
+#define IDT_SNAPSHOT 4                          // Timer that saves the history for the next session
+#define SNAPSHOT_INTERVAL 60000                 // Milliseconds between saves
 
 // Global Variables:
 HINSTANCE hInst;                                // current instance
@@ -34,15 +88,49 @@ CHOOSEFONT sChooseFont;                         // The ChooseFont structure for
 LOGFONT sLogFont;                               // The LogFont structure for the paint procedure
 BOOL bChooseFont = false;                       // The result of calling ChooseFont
 HFONT hFont = 0, hOldFont = 0;                  // Old and new fonts for the paint procedure
+EventMerger merger;                             // Merges the capture sources into one ordered stream
+EventQueue* pWindowQueue = NULL;                // Capture source 0, the messages sent to the main window
+RawInputSource rawInputSource;                  // Optional capture of every keyboard and mouse
+LoadGenerator loadGenerator;                    // Optional synthetic load
+UINT loadStartSequence = 0;                     // Sequence number when the load test started
+PatternDetector patternDetector;                // Key patterns to alert on
+TCHAR szAlert[MAX_ALERT_LEN] = _T("");          // The most recent pattern alert
+HeatMap heatMap;                                // Clicks and drags over the virtual screen
+BOOL bHeatMapView = false;                      // Display the heat map instead of the messages
+TrajectoryAnalyzer* pTrajectory[MAX_SOURCES];   // Recent moves of each capture source, allocated on first move
+UINT trajectorySource = 0;                      // The source that moved most recently
+TCHAR szTrajectory[MAX_STATUS_LEN] = _T("");    // Trajectory statistics of that source
+EventHistory history;                           // Every recorded message, by sequence number
+DisplayRows displayRows;                        // The rows on display, newest first
+BOOL bFoldRepeats = false;                      // Fold key autorepeat into one row per run
+BOOL bJoinKeystrokes = false;                   // Join the messages of each key press into one row
+int cyRow = 0;                                  // Row height of the last paint, 0 before the first
+HistorySnapshot frozen;                         // The history as it was when the display was frozen
+BOOL bFrozen = false;                           // Display the frozen history instead of the live rows
+UINT frozenTop = 0;                             // Sequence number of the top row while frozen
+OverloadController overload;                    // How much input to shed, and what was shed
+EventRecord unformatted[MAX_MESSAGES];          // The newest messages of a drain, while formatting is shed
+UINT cUnformatted = 0;                          // Messages put in unformatted[] during the drain
+TypedText typedText;                            // The text reconstructed from the typed characters
+TCHAR szFind[MAX_QUERY_LEN + 1] = _T("");       // The typed text to find
+UINT findFrom = 0;                              // Position to find the next occurrence from
+HistoryFile historyFile;                        // The snapshot files of the history
 
 // Forward declarations of functions included in this code module:
 ATOM                MyRegisterClass(HINSTANCE hInstance);
 BOOL                InitInstance(HINSTANCE, int);
 LRESULT CALLBACK    WndProc(HWND, UINT, WPARAM, LPARAM);
 INT_PTR CALLBACK    About(HWND, UINT, WPARAM, LPARAM);
-const TCHAR* GetMessageText(UINT);
-const TCHAR* GetExtendedStatus(LPARAM);
-const TCHAR* MouseButtons(WPARAM);
+INT_PTR CALLBACK    FindTyped(HWND, UINT, WPARAM, LPARAM);
+UINT                DrainCapturedEvents(HWND);
+void                RecordEvent(HWND, const EventRecord&, UINT, UINT*);
+void                FormatOverload(TCHAR*, size_t);
+void                InvalidateRows(HWND, UINT);
+void                RebuildRows();
+void                SetFrozenScroll(HWND);
+void                Freeze(HWND, UINT);
+BOOL                SaveCapture(HWND);
+void                PaintHeatMap(HWND, HDC);
 
 int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 	_In_opt_ HINSTANCE hPrevInstance,
@@ -132,6 +220,7 @@ ATOM MyRegisterClass(HINSTANCE hInstance)
 //        In this function, we save the instance handle in a global variable and
 //        create and display the main program window. RestoreWindowPlacement is
 //        called to restore the window to the size and position it last had.
+//        The history of the last session is mapped, and the time it took is shown.
 //
 BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
 {
@@ -154,6 +243,50 @@ BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
 	sChooseFont.lpLogFont = &sLogFont;
 	sChooseFont.Flags = CF_INITTOLOGFONTSTRUCT | CF_FIXEDPITCHONLY | CF_EFFECTS;
 
+	// Create the capture source for the messages sent to this window,
+	// and start the timer that merges in the other capture sources
+	pWindowQueue = merger.AddSource(WINDOW_QUEUE_CAPACITY, NULL);
+	SetTimer(hWnd, IDT_MERGE, MERGE_INTERVAL, NULL);
+
+	// Size the heat map to the virtual screen and start its decay
+	heatMap.Init(GetSystemMetrics(SM_XVIRTUALSCREEN), GetSystemMetrics(SM_YVIRTUALSCREEN),
+		GetSystemMetrics(SM_CXVIRTUALSCREEN), GetSystemMetrics(SM_CYVIRTUALSCREEN));
+	SetTimer(hWnd, IDT_HEATMAP, HEAT_DECAY_INTERVAL, NULL);
+	SetTimer(hWnd, IDT_TRAJECTORY, TRAJECTORY_INTERVAL, NULL);
+
+	// Load the key pattern rules from the .rules file next to the executable
+	TCHAR szRules[MAX_PATH];
+	if (GetModuleFileName(NULL, szRules, MAX_PATH))
+	{
+		TCHAR* pszExtension = _tcsrchr(szRules, _T('.'));
+		if (pszExtension) *pszExtension = 0;
+		if (SUCCEEDED(StringCchCat(szRules, MAX_PATH, _T(".rules"))) && patternDetector.LoadRules(szRules))
+		{
+			patternDetector.Compile();
+		}
+	}
+
+	// Map the history saved by the last session next to the executable, and save it at intervals
+	TCHAR szHistory[MAX_PATH];
+	if (GetModuleFileName(NULL, szHistory, MAX_PATH))
+	{
+		TCHAR* pszExtension = _tcsrchr(szHistory, _T('.'));
+		if (pszExtension) *pszExtension = 0;
+		if (historyFile.Init(szHistory))
+		{
+			ULONGLONG start = EventTimestamp();
+			UINT cRestored = historyFile.Restore(&history);
+			if (cRestored)
+			{
+				RebuildRows();
+				StringCchPrintf(szAlert, MAX_ALERT_LEN, _T("Restored:  %u messages in %.1f ms\t "),
+					cRestored, (EventTimestamp() - start) / 1000.0);
+				InvalidateRect(hWnd, NULL, true);
+			}
+			SetTimer(hWnd, IDT_SNAPSHOT, SNAPSHOT_INTERVAL, NULL);
+		}
+	}
+
 	// Instantiate ApplicationRegistry class and load/restore window placement
 	ApplicationRegistry ar;
 	if (ar.Init(hWnd))
@@ -194,8 +327,6 @@ BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
 
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
-	static UINT sequence = 0;
-
 	// Application Registry class for saving and loading memory blocks
 	ApplicationRegistry ar;
 	ar.Init(hWnd);
@@ -203,17 +334,6 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 	// Boolean flags to control mouse move recording
 	static bool LButtonDown = false, RButtonDown = false, MButtonDown = false, XButtonDown = false;
 
-	// Message array
-	#define MAX_MESSAGES 50
-	typedef struct
-	{
-		UINT sequence;
-		UINT message;
-		WPARAM wParam;
-		LPARAM lParam;
-	} mqstruct;
-	static mqstruct mq[MAX_MESSAGES];
-
 	// Process the message
 	switch (message)
 	{
@@ -235,6 +355,115 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 				}
 			}
 			break;
+		case ID_EDIT_CAPTUREALLDEVICES:
+			// Toggle the capture of every keyboard and mouse through Raw Input
+			if (rawInputSource.isRunning())
+			{
+				rawInputSource.Stop();
+			}
+			else if (!rawInputSource.Start(&merger))
+			{
+				MessageBox(hWnd, _T("ERROR: Unable to register for raw input!"), szTitle, MB_OK | MB_ICONSTOP);
+			}
+			CheckMenuItem(GetMenu(hWnd), ID_EDIT_CAPTUREALLDEVICES,
+				rawInputSource.isRunning() ? MF_CHECKED : MF_UNCHECKED);
+			break;
+		case ID_EDIT_LOADTEST:
+			// Toggle a mixed synthetic load on all but one processor, and report the result when stopped
+			if (loadGenerator.isRunning())
+			{
+				loadGenerator.Stop();
+				DrainCapturedEvents(hWnd);
+				LoadStats ls;
+				loadGenerator.GetStats(&ls);
+				UINT recorded = history.Last() - loadStartSequence;
+				#define MAX_REPORT_LEN 400
+				TCHAR szReport[MAX_REPORT_LEN];
+				StringCchPrintf(szReport, MAX_REPORT_LEN,
+					_T("Seconds:  %.2f\nGenerated:  %llu (%.0f/s)\nRecorded:  %u (%.0f/s)\nDropped:  %llu (%.2f%%)\n")
+					_T("Coalesced:  %llu\nSampled out:  %llu\nNot displayed:  %llu\nMerged late:  %llu\nPeak lag:  %.1f ms"),
+					ls.seconds, ls.generated, ls.generated / ls.seconds, recorded, recorded / ls.seconds,
+					ls.dropped, ls.generated ? 100.0 * ls.dropped / ls.generated : 0.0,
+					overload.ShedAt(SHED_COALESCE), overload.ShedAt(SHED_SAMPLE), overload.ShedAt(SHED_NOFORMAT),
+					overload.Late(), overload.PeakLag() / 1000.0);
+				MessageBox(hWnd, szReport, szTitle, MB_OK | MB_ICONINFORMATION);
+			}
+			else
+			{
+				LoadConfig lc;
+				LoadConfigProfile(&lc, LOAD_PROFILE_MIXED);
+				SYSTEM_INFO si;
+				GetSystemInfo(&si);
+				lc.cThreads = si.dwNumberOfProcessors > 1 ? si.dwNumberOfProcessors - 1 : 1;
+				loadStartSequence = history.Last();
+				overload.Reset();
+				loadGenerator.Start(&merger, lc);
+			}
+			CheckMenuItem(GetMenu(hWnd), ID_EDIT_LOADTEST,
+				loadGenerator.isRunning() ? MF_CHECKED : MF_UNCHECKED);
+			break;
+		case ID_EDIT_FOLDREPEATS:
+			// Toggle folding of key autorepeat, and show the recent history the new way
+			bFoldRepeats = !bFoldRepeats;
+			CheckMenuItem(GetMenu(hWnd), ID_EDIT_FOLDREPEATS, bFoldRepeats ? MF_CHECKED : MF_UNCHECKED);
+			RebuildRows();
+			InvalidateRect(hWnd, NULL, false);
+			break;
+		case ID_VIEW_KEYSTROKES:
+			// Toggle between one row per keystroke and the raw messages, and show the recent
+			// history the new way
+			bJoinKeystrokes = !bJoinKeystrokes;
+			CheckMenuItem(GetMenu(hWnd), ID_VIEW_KEYSTROKES, bJoinKeystrokes ? MF_CHECKED : MF_UNCHECKED);
+			RebuildRows();
+			InvalidateRect(hWnd, NULL, false);
+			break;
+		case ID_VIEW_FREEZE:
+			// Toggle between the live rows and a snapshot of the history, which can be scrolled
+			// through while capture continues
+			if (bFrozen)
+			{
+				bFrozen = false;
+				frozen.Release();
+				SetFrozenScroll(hWnd);
+				CheckMenuItem(GetMenu(hWnd), ID_VIEW_FREEZE, MF_UNCHECKED);
+				InvalidateRect(hWnd, NULL, true);
+			}
+			else
+			{
+				Freeze(hWnd, 0);
+			}
+			break;
+		case ID_EDIT_FINDTYPED:
+			// Find the next occurrence of text in the typed text, wrapping around at the end,
+			// and freeze the display on the messages that typed it
+			if (DialogBox(hInst, MAKEINTRESOURCE(IDD_FINDTYPED), hWnd, FindTyped) == IDOK && szFind[0])
+			{
+				UINT position = typedText.Find(szFind, findFrom);
+				if (position == TEXT_NOT_FOUND && findFrom) position = typedText.Find(szFind, 0);
+				if (position == TEXT_NOT_FOUND)
+				{
+					findFrom = 0;
+					MessageBox(hWnd, _T("The text was not typed."), szTitle, MB_OK | MB_ICONINFORMATION);
+					break;
+				}
+				findFrom = position + 1;
+
+				TCHAR ch;
+				UINT sequence = 0;
+				typedText.CharAt(position, &ch, &sequence);
+				StringCchPrintf(szAlert, MAX_ALERT_LEN, _T("Found:  \"%s\" typed from sequence %08d\t "), szFind, sequence);
+				Freeze(hWnd, sequence + MAX_MESSAGES / 2);
+			}
+			break;
+		case ID_VIEW_HEATMAP:
+			// Toggle between the messages and the heat map
+			bHeatMapView = !bHeatMapView;
+			CheckMenuItem(GetMenu(hWnd), ID_VIEW_HEATMAP, bHeatMapView ? MF_CHECKED : MF_UNCHECKED);
+			InvalidateRect(hWnd, NULL, true);
+			break;
+		case ID_FILE_SAVECAPTURE:
+			SaveCapture(hWnd);
+			break;
 		case IDM_ABOUT:
 			DialogBox(hInst, MAKEINTRESOURCE(IDD_ABOUTBOX), hWnd, About);
 			break;
@@ -253,6 +482,13 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 		PAINTSTRUCT ps;
 		HDC hdc = BeginPaint(hWnd, &ps);
 
+		if (bHeatMapView)
+		{
+			PaintHeatMap(hWnd, hdc);
+			EndPaint(hWnd, &ps);
+			break;
+		}
+
 		if (bChooseFont)
 		{
 			hOldFont = (HFONT)SelectObject(hdc, CreateFontIndirect(&sLogFont));
@@ -263,122 +499,113 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 		TEXTMETRIC tm;
 		GetTextMetrics(hdc, &tm);
 		int x = 10;
-		int y = 10;
+		int y = ROWS_TOP;
+		cyRow = tm.tmHeight;
 
 		// A buffer to format each line of text
-		#define MAX_BUFFER_LEN 125
+		#define MAX_BUFFER_LEN 175
 		TCHAR sz[MAX_BUFFER_LEN];
 
-		// Tabstops for each type of line of text
-		const int TabStopsKeyboard[] =
-		{                            // "Sequence:  99999999"
-			 24 * tm.tmMaxCharWidth, // "\tMessage:  AAAAAAAAAAAAAAAA"
-			 52 * tm.tmMaxCharWidth, // "\tExt:  "
-			 58 * tm.tmMaxCharWidth, // "\tU"            (Up)
-			 60 * tm.tmMaxCharWidth, // "\tR"            (Repeat)
-			 62 * tm.tmMaxCharWidth, // "\tA"            (Alt)
-			 64 * tm.tmMaxCharWidth, // "\tM"            (Menu)
-			 66 * tm.tmMaxCharWidth, // "\tD"            (Dialog)
-			 68 * tm.tmMaxCharWidth, // "\tX"            (Extended)
-			 74 * tm.tmMaxCharWidth, // "\tSC:  0xFFFF"  (Scan Code)
-			 90 * tm.tmMaxCharWidth, // "\tRC:  0xFFFF"  (Repeat Count)
-			105 * tm.tmMaxCharWidth, // "\twParam:  0xFFFFFFFFFFFFFFFF"
-			150 * tm.tmMaxCharWidth  // "\t "
-		};
-		const int TabStopsMouseMove[] =
-		{	                         // "Sequence:  99999999"
-			 24 * tm.tmMaxCharWidth, // "\tMessage:  AAAAAAAAAAAAAAAA"
-			 55 * tm.tmMaxCharWidth, // "\tPoint:  (+9999,+9999)"
-			 79 * tm.tmMaxCharWidth, // "\tVKeyStatus:"
-			 92 * tm.tmMaxCharWidth, // "\t2"
-			 94 * tm.tmMaxCharWidth, // "\t1"
-			 96 * tm.tmMaxCharWidth, // "\tM"
-			 98 * tm.tmMaxCharWidth, // "\tC"
-			100 * tm.tmMaxCharWidth, // "\tS"
-			102 * tm.tmMaxCharWidth, // "\tR"
-			104 * tm.tmMaxCharWidth, // "\tL"
-			150 * tm.tmMaxCharWidth, // "\t "
-		};
-		const int TabStopsMouseWheel[] =
-		{                            // "Sequence:  99999999"
-			 24 * tm.tmMaxCharWidth, // "\tMessage:  AAAAAAAAAAAAAAAA"
-			 55 * tm.tmMaxCharWidth, // "\tPoint:  (+9999,+9999)"
-			 79 * tm.tmMaxCharWidth, // "\tVKeyStatus:"
-			 92 * tm.tmMaxCharWidth, // "\t2"
-			 94 * tm.tmMaxCharWidth, // "\t1"
-			 96 * tm.tmMaxCharWidth, // "\tM"
-			 98 * tm.tmMaxCharWidth, // "\tC"
-			100 * tm.tmMaxCharWidth, // "\tS"
-			102 * tm.tmMaxCharWidth, // "\tR"
-			104 * tm.tmMaxCharWidth, // "\tL"
-			109 * tm.tmMaxCharWidth, // "\tWheel:  +"
-			118 * tm.tmMaxCharWidth, // "\t9999"
-			150 * tm.tmMaxCharWidth  // "\t "
-		};
-		const int TabStopsMouseClick[] =
-		{                            // "Sequence:  99999999"
-			 24 * tm.tmMaxCharWidth, // "\tMessage:  AAAAAAAAAAAAAAAA"
-			 55 * tm.tmMaxCharWidth, // "\tPoint:  (+9999,+9999)"
-			 79 * tm.tmMaxCharWidth, // "\tVKeyStatus:"
-			 92 * tm.tmMaxCharWidth, // "\t2"
-			 94 * tm.tmMaxCharWidth, // "\t1"
-			 96 * tm.tmMaxCharWidth, // "\tM"
-			 98 * tm.tmMaxCharWidth, // "\tC"
-			100 * tm.tmMaxCharWidth, // "\tS"
-			102 * tm.tmMaxCharWidth, // "\tR"
-			104 * tm.tmMaxCharWidth, // "\tL"
-			150 * tm.tmMaxCharWidth  // "\t "
-		};
+		// Tabstops for each type of line of text, from the layouts in the message table
+		int TabStops[MAX_TAB_STOPS];
 		#define SIZEOFINT(p) (sizeof(p) / sizeof(int)) // A macro to return the number of tabs in each tabstop array
 
-		// For each entry in the message array
+		// For each displayed row
 		int cbsz;
 		for (int i = 0; i < MAX_MESSAGES; i++)
 		{
-			if (mq[i].message >= WM_KEYFIRST && mq[i].message <= WM_KEYLAST)
+			// Skip the rows outside the update region, such as all but the top row of a folded run
+			if (y + tm.tmHeight <= ps.rcPaint.top || y >= ps.rcPaint.bottom)
 			{
-				// Format and display keyboard message
-				StringCchPrintf(sz, MAX_BUFFER_LEN,
-					_T("Sequence:  %08d\tMessage:  %s\tExt:  %s\twParam:  0x%016llX\t "),
-					mq[i].sequence, GetMessageText(mq[i].message), GetExtendedStatus(mq[i].lParam), mq[i].wParam);
-				cbsz = lstrlen(sz); // usage: 113 out of 125
-				TabbedTextOut(hdc, x, y, sz, cbsz, SIZEOFINT(TabStopsKeyboard), TabStopsKeyboard, 10);
+				y += tm.tmHeight;
+				continue;
 			}
-			if (mq[i].message == WM_MOUSEMOVE)
+
+			// While frozen, the rows come from the snapshot, one per message
+			DisplayRow frozenRow;
+			if (bFrozen)
 			{
-				// Format and display mouse move message
-				StringCchPrintf(sz, MAX_BUFFER_LEN,
-					_T("Sequence:  %08d\tMessage:  %s\tPoint:  (%+05d,%+05d)\tVKeyStatus:  %s\t "),
-					mq[i].sequence, GetMessageText(mq[i].message),
-					GET_X_LPARAM(mq[i].lParam), GET_Y_LPARAM(mq[i].lParam),
-					MouseButtons(GET_KEYSTATE_WPARAM(mq[i].wParam)));
-				cbsz = lstrlen(sz); // usage: 94 out of 125
-				TabbedTextOut(hdc, x, y, sz, cbsz, SIZEOFINT(TabStopsMouseMove), TabStopsMouseMove, 10);
+				ZeroMemory(&frozenRow, sizeof(frozenRow));
+				if (frozenTop > (UINT)i) frozen.Get(frozenTop - i, &frozenRow.er);
 			}
-			if (mq[i].message == WM_MOUSEWHEEL)
+
+			const DisplayRow& row = bFrozen ? frozenRow : displayRows.Row(i);
+
+			// Format and display the keystroke, the folded run of key autorepeat, or the
+			// message as the message table describes its class
+			const RowLayout& layout = row.bKeystroke ? layoutKeystroke :
+				row.cRepeats ? layoutRepeat : *DescribeMessage(row.er.message).pLayout;
+			if (row.bKeystroke) cbsz = (int)FormatKeystrokeRow(sz, MAX_BUFFER_LEN, row);
+			else if (row.cRepeats) cbsz = (int)FormatFoldedRow(sz, MAX_BUFFER_LEN, row);
+			else cbsz = (int)FormatRow(sz, MAX_BUFFER_LEN, row.er);
+			if (cbsz)
 			{
-				// Format and display mouse wheel message
-				StringCchPrintf(sz, MAX_BUFFER_LEN,
-					_T("Sequence:  %08d\tMessage:  %s\tPoint:  (%+05d,%+05d)\tVKeyStatus:  %s\tWheel:  %+05d\t "),
-					mq[i].sequence, GetMessageText(mq[i].message),
-					GET_X_LPARAM(mq[i].lParam), GET_Y_LPARAM(mq[i].lParam),
-					MouseButtons(GET_KEYSTATE_WPARAM(mq[i].wParam)), GET_WHEEL_DELTA_WPARAM(mq[i].wParam));
-				cbsz = lstrlen(sz); // usage: 109 out of 125
-				TabbedTextOut(hdc, x, y, sz, cbsz, SIZEOFINT(TabStopsMouseWheel), TabStopsMouseWheel, 10);
+				for (UINT t = 0; t < layout.cTabStops; t++) TabStops[t] = layout.tabStop[t] * tm.tmMaxCharWidth;
+				TabbedTextOut(hdc, x, y, sz, cbsz, layout.cTabStops, TabStops, 10);
 			}
-			if (mq[i].message > WM_MOUSEFIRST && mq[i].message <= WM_MOUSELAST && mq[i].message != WM_MOUSEWHEEL)
+			y += tm.tmHeight;
+		}
+
+		// Display what is frozen below the messages
+		const int TabStopsStatus[] =
+		{
+			150 * tm.tmMaxCharWidth  // "\t "
+		};
+		if (bFrozen)
+		{
+			if (frozen.isValid())
 			{
-				// Format and display mouse click message
 				StringCchPrintf(sz, MAX_BUFFER_LEN,
-					_T("Sequence:  %08d\tMessage:  %s\tPoint:  (%+05d,%+05d)\tVKeyStatus:  %s\t "),
-					mq[i].sequence, GetMessageText(mq[i].message),
-					GET_X_LPARAM(mq[i].lParam), GET_Y_LPARAM(mq[i].lParam), MouseButtons(mq[i].wParam));
-				cbsz = lstrlen(sz); // usage: 96 out of 125
-				TabbedTextOut(hdc, x, y, sz, cbsz, SIZEOFINT(TabStopsMouseClick), TabStopsMouseClick, 10);
+					_T("Frozen:  %08d to %08d  (%u recorded since)\t "),
+					frozen.First(), frozen.Last(), history.Last() - frozen.Last());
+			}
+			else
+			{
+				StringCchCopy(sz, MAX_BUFFER_LEN, _T("Frozen:  released to bound memory, freeze again\t "));
+			}
+			TabbedTextOut(hdc, x, y, sz, lstrlen(sz), SIZEOFINT(TabStopsStatus), TabStopsStatus, 10);
+			y += tm.tmHeight;
+		}
+
+		// Display the overload level and what was shed or lost, once anything was
+		if (overload.Level() != SHED_NONE || overload.ShedAt(SHED_COALESCE) || overload.ShedAt(SHED_NOFORMAT) ||
+			overload.ShedAt(SHED_SAMPLE) || overload.Dropped() || overload.Late())
+		{
+			TCHAR szOverload[MAX_OVERLOAD_LEN];
+			FormatOverload(szOverload, MAX_OVERLOAD_LEN);
+			TabbedTextOut(hdc, x, y, szOverload, lstrlen(szOverload), SIZEOFINT(TabStopsStatus), TabStopsStatus, 10);
+			y += tm.tmHeight;
+		}
+
+		// Display the typed text up to the cursor, one line with the line breaks marked
+		if (typedText.Length())
+		{
+			TCHAR szTyped[MAX_TYPED_TAIL + 1];
+			UINT from = typedText.Cursor() > MAX_TYPED_TAIL ? typedText.Cursor() - MAX_TYPED_TAIL : 0;
+			UINT cch = typedText.GetText(from, szTyped, typedText.Cursor() - from + 1);
+			for (UINT i = 0; i < cch; i++)
+			{
+				if (szTyped[i] == _T('\n')) szTyped[i] = (TCHAR)0x00B6; // Pilcrow
+				if (szTyped[i] == _T('\t')) szTyped[i] = _T(' ');
 			}
+			StringCchPrintf(sz, MAX_BUFFER_LEN, _T("Typed:  %s\t "), szTyped);
+			TabbedTextOut(hdc, x, y, sz, lstrlen(sz), SIZEOFINT(TabStopsStatus), TabStopsStatus, 10);
+			y += tm.tmHeight;
+		}
+
+		// Display the most recent pattern alert
+		if (szAlert[0])
+		{
+			TabbedTextOut(hdc, x, y, szAlert, lstrlen(szAlert), SIZEOFINT(TabStopsStatus), TabStopsStatus, 10);
 			y += tm.tmHeight;
 		}
 
+		// Display the trajectory statistics of the mouse that moved last
+		if (szTrajectory[0])
+		{
+			TabbedTextOut(hdc, x, y, szTrajectory, lstrlen(szTrajectory), SIZEOFINT(TabStopsStatus), TabStopsStatus, 10);
+		}
+
 		if (bChooseFont)
 		{
 			SelectObject(hdc, hOldFont);
@@ -436,29 +663,108 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 		// Filter mouse move to only record when at least one of the buttons is down
 		if (message == WM_MOUSEMOVE && !LButtonDown && !RButtonDown && !MButtonDown && !XButtonDown) break;
 
-		// Shift message queuee array up by one
-		for (int i = MAX_MESSAGES - 1; i > 0; i--)
+		// Queue the message as capture source 0 and merge it into the message array
+		EventRecord er;
+		er.sequence = 0;
+		er.message = message;
+		er.wParam = wParam;
+		er.lParam = lParam;
+		er.timestamp = EventTimestamp();
+		er.source = 0;
+		BOOL bQueued = pWindowQueue->Push(er);
+
+		// Under overload leave the draining to the timer, unless the window queue is filling up
+		// or was full, in which case the queue counted the message as dropped
+		if (bQueued && overload.Level() >= SHED_NOFORMAT && pWindowQueue->Depth() < WINDOW_QUEUE_CAPACITY / 2) break;
+
+		// Repaint client window without erasing it - Forces WM_PAINT message,
+		// synchronously only when not overloaded
+		UINT changed = DrainCapturedEvents(hWnd);
+		if (changed)
 		{
-			mq[i].sequence = mq[i - 1].sequence;
-			mq[i].message = mq[i - 1].message;
-			mq[i].wParam = mq[i - 1].wParam;
-			mq[i].lParam = mq[i - 1].lParam;
+			InvalidateRows(hWnd, changed);
+			if (overload.Level() == SHED_NONE) UpdateWindow(hWnd);
 		}
-
-		// Add the current message to the top of the array
-		mq[0].sequence = ++sequence;
-		mq[0].message = message;
-		mq[0].lParam = lParam;
-		mq[0].wParam = wParam;
-
-		// Repaint client window without erasing it - Forces WM_PAINT message
-		InvalidateRect(hWnd, NULL, false);
-		UpdateWindow(hWnd);
 	}
 	break;
 
+	// Scroll through the frozen history
+	case WM_VSCROLL:
+		if (bFrozen && frozen.isValid())
+		{
+			SCROLLINFO si;
+			si.cbSize = sizeof(si);
+			si.fMask = SIF_ALL;
+			GetScrollInfo(hWnd, SB_VERT, &si);
+			int pos = si.nPos;
+			switch (LOWORD(wParam))
+			{
+			case SB_TOP:           pos = si.nMin; break;
+			case SB_BOTTOM:        pos = si.nMax; break;
+			case SB_LINEUP:        pos -= 1; break;
+			case SB_LINEDOWN:      pos += 1; break;
+			case SB_PAGEUP:        pos -= MAX_MESSAGES; break;
+			case SB_PAGEDOWN:      pos += MAX_MESSAGES; break;
+			case SB_THUMBTRACK:    pos = si.nTrackPos; break;
+			}
+			if (pos > si.nMax - (int)si.nPage + 1) pos = si.nMax - (int)si.nPage + 1;
+			if (pos < si.nMin) pos = si.nMin;
+			frozenTop = frozen.Last() - pos;
+			SetFrozenScroll(hWnd);
+			InvalidateRect(hWnd, NULL, false);
+		}
+		break;
+
+	// Merge in the messages of the other capture sources
+	case WM_TIMER:
+		if (wParam == IDT_MERGE)
+		{
+			// Nothing older than now can still arrive from this window
+			pWindowQueue->Heartbeat(EventTimestamp());
+			UINT changed = DrainCapturedEvents(hWnd);
+			if (changed)
+			{
+				InvalidateRows(hWnd, changed);
+				if (overload.Level() == SHED_NONE) UpdateWindow(hWnd);
+			}
+		}
+		if (wParam == IDT_SNAPSHOT)
+		{
+			historyFile.Save(&history, false);
+		}
+		if (wParam == IDT_HEATMAP)
+		{
+			heatMap.Decay(HEAT_DECAY_FACTOR);
+			if (bHeatMapView) InvalidateRect(hWnd, NULL, false);
+		}
+		if (wParam == IDT_TRAJECTORY && pTrajectory[trajectorySource])
+		{
+			TrajectoryStats ts;
+			if (pTrajectory[trajectorySource]->Analyze(&ts))
+			{
+				StringCchPrintf(szTrajectory, MAX_STATUS_LEN,
+					_T("Mouse:  source %u  %.0f Hz  jitter %.0f us  speed %.0f px/s (peak %.0f)  accel %.0f px/s2 (peak %.0f)\t "),
+					trajectorySource, ts.pollingRate, ts.intervalJitter * 1e6f, ts.meanSpeed, ts.peakSpeed,
+					ts.meanAcceleration, ts.peakAcceleration);
+				if (!bHeatMapView) InvalidateRect(hWnd, NULL, false);
+			}
+		}
+		break;
+
 	// Process the close message sent by the menu message handler
 	case WM_DESTROY:
+		// Stop the capture threads before the merger goes away
+		KillTimer(hWnd, IDT_MERGE);
+		KillTimer(hWnd, IDT_HEATMAP);
+		KillTimer(hWnd, IDT_TRAJECTORY);
+		KillTimer(hWnd, IDT_SNAPSHOT);
+		rawInputSource.Stop();
+		loadGenerator.Stop();
+		for (int i = 0; i < MAX_SOURCES; i++) delete pTrajectory[i];
+
+		// Save the history for the next session
+		historyFile.Save(&history, true);
+
 		// Save window placement to the registry
 		if (ar.Init(hWnd))
 		{
@@ -483,102 +789,384 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 
 
 //
-//  FUNCTION: GetMessageText(UINT)
+//  FUNCTION: DrainCapturedEvents(HWND)
+//
+//  PURPOSE: Records the merged messages of all capture sources in the history and the rows
+//
+//  COMMENTS:
 //
-//  PURPOSE: Decodes message type - Helper to the paint procedure
+//        Returns what changed in the rows (a ROWS_ value), so the caller repaints once for
+//        the whole batch rather than once per message, and only the top row when nothing
+//        else changed. At most MAX_DRAIN messages are merged per call, the rest wait for
+//        the next timer tick.
 //
+//        Under overload, messages are shed at the level the overload controller set after
+//        the previous drain: runs of moves of one source with the same buttons are
+//        coalesced into their last move, only the newest MAX_MESSAGES messages of the batch
+//        are added to the rows, and most moves are sampled out, while every click and
+//        wheel turn is kept. Sampled out moves cost next to nothing, so more of them are
+//        merged per call.
+//
+UINT DrainCapturedEvents(HWND hWnd)
+{
+	UINT changed = ROWS_UNCHANGED;
+	UINT level = overload.Level();
+	UINT cMax = level >= SHED_SAMPLE ? MAX_DRAIN * SHED_SAMPLE_RATE : MAX_DRAIN;
+	UINT lastBefore = history.Last();
+	EventRecord er;
+	EventRecord move;                           // The move being coalesced
+	BOOL bMove = false;
+
+	merger.Poll(EventTimestamp());
+	cUnformatted = 0;
+	for (UINT cDrained = 0; cDrained < cMax && merger.Next(er); cDrained++)
+	{
+		if (!overload.Sample(er.message)) continue;
 
-const TCHAR* GetMessageText(UINT message)
+		// Hold each move until the next message shows whether it continues the run
+		if (level >= SHED_COALESCE && er.message == WM_MOUSEMOVE)
+		{
+			if (bMove && move.source == er.source && move.wParam == er.wParam)
+			{
+				overload.Shed(SHED_COALESCE, WM_MOUSEMOVE);
+			}
+			else if (bMove)
+			{
+				RecordEvent(hWnd, move, level, &changed);
+			}
+			move = er;
+			bMove = true;
+			continue;
+		}
+		if (bMove)
+		{
+			RecordEvent(hWnd, move, level, &changed);
+			bMove = false;
+		}
+		RecordEvent(hWnd, er, level, &changed);
+	}
+	if (bMove) RecordEvent(hWnd, move, level, &changed);
+
+	// Add the newest messages of the batch to the rows, the others were counted as not displayed
+	UINT first = cUnformatted > MAX_MESSAGES ? cUnformatted - MAX_MESSAGES : 0;
+	for (UINT i = first; i < cUnformatted; i++)
+	{
+		UINT rows = displayRows.Add(unformatted[i % MAX_MESSAGES], bFoldRepeats, bJoinKeystrokes);
+		if (rows > changed) changed = rows;
+	}
+
+	// Adjust the level to how far behind the newest message was, past the reorder window
+	ULONGLONG now = EventTimestamp();
+	ULONGLONG lag = 0;
+	if (history.Last() != lastBefore && history.Get(history.Last(), &er) &&
+		now > er.timestamp + merger.ReorderWindow())
+	{
+		lag = now - er.timestamp - merger.ReorderWindow();
+	}
+	overload.Update(merger.Depth(), lag, now);
+	if (overload.Level() != level) changed = ROWS_SHIFTED;
+
+	// Count what the capture queues dropped and the merge released late since the last drain
+	ULONGLONG dropped[MESSAGE_SLOTS + 1] = {};
+	merger.TakeDropped(dropped);
+	ULONGLONG late = merger.TakeLate();
+	ULONGLONG lostBefore = overload.Dropped() + overload.Late();
+	overload.Lost(dropped, late);
+	if (overload.Dropped() + overload.Late() != lostBefore) changed = ROWS_SHIFTED;
+
+	return changed;
+}
+
+
+
+//
+//  FUNCTION: RecordEvent(HWND, const EventRecord&, UINT, UINT*)
+//
+//  PURPOSE: Records one message in the history, the rows, the pattern detector, the heat
+//           map and the trajectory statistics
+//
+//  COMMENTS:
+//
+//        Raises *pChanged to what changed in the rows.
+//
+//        From level SHED_NOFORMAT on, the message is kept in unformatted[] instead of being
+//        added to the rows; the caller adds the newest MAX_MESSAGES of those afterwards, and
+//        the ones overwritten before then are counted as not displayed.
+//
+//        Mouse positions are accumulated in the heat map in screen coordinates.
+//        Only the messages of the main window (source 0) are in client coordinates.
+//
+void RecordEvent(HWND hWnd, const EventRecord& erIn, UINT level, UINT* pChanged)
 {
-	switch (message)
+	EventRecord er = erIn;
+
+	// Record the message and add or fold it into the rows
+	history.Append(er);
+	if (level < SHED_NOFORMAT)
+	{
+		UINT rows = displayRows.Add(er, bFoldRepeats, bJoinKeystrokes);
+		if (rows > *pChanged) *pChanged = rows;
+	}
+	else
+	{
+		EventRecord& slot = unformatted[cUnformatted % MAX_MESSAGES];
+		if (cUnformatted >= MAX_MESSAGES) overload.Shed(SHED_NOFORMAT, slot.message);
+		slot = er;
+		cUnformatted++;
+	}
+
+	// Alert on the key patterns that this message completes - One source only, as the raw
+	// input of the same keyboard repeats every key press of the main window
+	PatternMatch pm[MAX_MATCHES];
+	UINT cMatches = er.source == KEY_SOURCE ? patternDetector.OnEvent(er, pm, MAX_MATCHES) : 0;
+	if (cMatches)
+	{
+		StringCchPrintf(szAlert, MAX_ALERT_LEN, _T("Alert:  %s  (sequence %08d)\t "),
+			patternDetector.RuleText(pm[cMatches - 1].rule), pm[cMatches - 1].sequence);
+		MessageBeep(MB_ICONEXCLAMATION);
+		*pChanged = ROWS_SHIFTED;
+	}
+
+	// Reconstruct the typed text - Of the same source, so raw input does not edit it twice
+	if (er.source == KEY_SOURCE) typedText.OnEvent(er);
+
+	// Accumulate clicks and drags in the heat map
+	if (er.message >= WM_MOUSEFIRST && er.message <= WM_MOUSELAST && er.message != WM_MOUSEWHEEL)
+	{
+		POINT pt = { GET_X_LPARAM(er.lParam), GET_Y_LPARAM(er.lParam) };
+		if (er.source == 0) ClientToScreen(hWnd, &pt);
+		heatMap.AddMessage(er.message, pt.x, pt.y);
+
+		// Follow the moves of each source for the trajectory statistics
+		if (er.message == WM_MOUSEMOVE && er.source < MAX_SOURCES)
+		{
+			if (pTrajectory[er.source] == NULL) pTrajectory[er.source] = new TrajectoryAnalyzer;
+			pTrajectory[er.source]->Add(pt.x, pt.y, er.timestamp);
+			trajectorySource = er.source;
+		}
+	}
+}
+
+
+
+//
+//  FUNCTION: FormatOverload(TCHAR*, size_t)
+//
+//  PURPOSE: Formats the overload status line - The level, the lag, and per message type
+//           the count of messages that were coalesced or sampled out and not recorded,
+//           and of those the full capture queues dropped, then the count merged late
+//
+void FormatOverload(TCHAR* psz, size_t cch)
+{
+	StringCchPrintf(psz, cch, _T("Overload:  %s  peak lag %.1f ms  not displayed %llu  not recorded:"),
+		OverloadController::LevelText(overload.Level()), overload.PeakLag() / 1000.0,
+		overload.ShedAt(SHED_NOFORMAT));
+	for (UINT slot = 0; slot < MESSAGE_SLOTS; slot++)
+	{
+		ULONGLONG count = overload.NotRecorded(messageTable[slot].message);
+		if (count == 0) continue;
+
+		size_t len = lstrlen(psz);
+		StringCchPrintf(psz + len, cch - len, _T("  %s %llu"), messageTable[slot].pszName, count);
+	}
+	if (overload.Dropped())
+	{
+		StringCchCat(psz, cch, _T("  dropped:"));
+		for (UINT slot = 0; slot < MESSAGE_SLOTS; slot++)
+		{
+			ULONGLONG count = overload.Dropped(messageTable[slot].message);
+			if (count == 0) continue;
+
+			size_t len = lstrlen(psz);
+			StringCchPrintf(psz + len, cch - len, _T("  %s %llu"), messageTable[slot].pszName, count);
+		}
+	}
+	if (overload.Late())
+	{
+		size_t len = lstrlen(psz);
+		StringCchPrintf(psz + len, cch - len, _T("  late %llu"), overload.Late());
+	}
+	StringCchCat(psz, cch, _T("\t "));
+}
+
+
+
+//
+//  FUNCTION: InvalidateRows(HWND, UINT)
+//
+//  PURPOSE: Invalidates what DrainCapturedEvents() changed - Just the top row while folding,
+//           all of the rows when a keystroke further down was updated or a row was added
+//
+void InvalidateRows(HWND hWnd, UINT changed)
+{
+	if (bFrozen && cyRow && !bHeatMapView)
+	{
+		// Only the status lines change while frozen
+		RECT rc;
+		GetClientRect(hWnd, &rc);
+		rc.top = ROWS_TOP + MAX_MESSAGES * cyRow;
+		InvalidateRect(hWnd, &rc, false);
+	}
+	else if (changed == ROWS_TOP_UPDATED && cyRow && !bHeatMapView)
+	{
+		// The top row, and the status lines such as the typed text
+		RECT rc;
+		GetClientRect(hWnd, &rc);
+		LONG bottom = rc.bottom;
+		rc.top = ROWS_TOP;
+		rc.bottom = ROWS_TOP + cyRow;
+		InvalidateRect(hWnd, &rc, false);
+		rc.top = ROWS_TOP + MAX_MESSAGES * cyRow;
+		rc.bottom = bottom;
+		InvalidateRect(hWnd, &rc, false);
+	}
+	else
 	{
-	case WM_KEYDOWN:       /* 0x0100 */ return _T("WM_KEYDOWN");
-	case WM_KEYUP:         /* 0x0101 */ return _T("WM_KEYUP");
-	case WM_CHAR:          /* 0x0102 */ return _T("WM_CHAR");
-	case WM_DEADCHAR:      /* 0x0103 */ return _T("WM_DEADCHAR");
-	case WM_SYSKEYDOWN:    /* 0x0104 */ return _T("WM_SYSKEYDOWN");
-	case WM_SYSKEYUP:      /* 0x0105 */ return _T("WM_SYSKEYUP");
-	case WM_SYSCHAR:       /* 0x0106 */ return _T("WM_SYSCHAR");
-	case WM_SYSDEADCHAR:   /* 0x0107 */ return _T("WM_SYSDEADCHAR");
-
-	case WM_MOUSEMOVE:     /* 0x0200 */ return _T("WM_MOUSEMOVE");
-	case WM_LBUTTONDOWN:   /* 0x0201 */ return _T("WM_LBUTTONDOWN");
-	case WM_LBUTTONUP:     /* 0x0202 */ return _T("WM_LBUTTONUP");
-	case WM_LBUTTONDBLCLK: /* 0x0203 */ return _T("WM_LBUTTONDBLCLK");
-	case WM_RBUTTONDOWN:   /* 0x0204 */ return _T("WM_RBUTTONDOWN");
-	case WM_RBUTTONUP:     /* 0x0205 */ return _T("WM_RBUTTONUP");
-	case WM_RBUTTONDBLCLK: /* 0x0206 */ return _T("WM_RBUTTONDBLCLK");
-	case WM_MBUTTONDOWN:   /* 0x0207 */ return _T("WM_MBUTTONDOWN");
-	case WM_MBUTTONUP:     /* 0x0208 */ return _T("WM_MBUTTONUP");
-	case WM_MBUTTONDBLCLK: /* 0x0209 */ return _T("WM_MBUTTONDBLCLK");
-	case WM_MOUSEWHEEL:    /* 0x020A */ return _T("WM_MOUSEWHEEL");
-	case WM_XBUTTONDOWN:   /* 0x020B */ return _T("WM_XBUTTONDOWN");
-	case WM_XBUTTONUP:     /* 0x020C */ return _T("WM_XBUTTONUP");
-	case WM_XBUTTONDBLCLK: /* 0x020D */ return _T("WM_XBUTTONDBLCLK");
-
-	default:                            return _T("NOT_FOUND");
+		InvalidateRect(hWnd, NULL, false);
 	}
 }
 
 
 
 //
-//  FUNCTION: GetExtendedStatus(LPARAM)
+//  FUNCTION: RebuildRows()
 //
-//  PURPOSE: Decodes lParam in a keyboard message - Helper to the paint procedure
+//  PURPOSE: Rebuilds the rows from the most recent history, after folding or joining is switched
 //
+void RebuildRows()
+{
+	displayRows.Clear();
+	if (history.Last() == 0) return;
+
+	UINT first = history.Last() > MAX_REBUILD ? history.Last() - MAX_REBUILD + 1 : 1;
+	if (first < history.First()) first = history.First();
 
-const TCHAR* GetExtendedStatus(LPARAM lParam)
+	EventRecord er;
+	for (UINT sequence = first; sequence <= history.Last(); sequence++)
+	{
+		if (history.Get(sequence, &er)) displayRows.Add(er, bFoldRepeats, bJoinKeystrokes);
+	}
+}
+
+
+
+//
+//  FUNCTION: SetFrozenScroll(HWND)
+//
+//  PURPOSE: Shows the scroll bar over the frozen history, positioned at the top row, or hides it
+//
+//  COMMENTS:
+//
+//        Position 0 is the newest frozen message, so the bar reads from newest to oldest.
+//
+void SetFrozenScroll(HWND hWnd)
 {
-	#define MAXSZ1 42
-	static TCHAR sz1[MAXSZ1];
-	StringCchCopy(sz1, MAXSZ1, _T(""));
-
-	StringCchCat(sz1, MAXSZ1, HIWORD(lParam) & KF_UP ? _T("U") : _T("_"));
-	StringCchCat(sz1, MAXSZ1, HIWORD(lParam) & KF_REPEAT ? _T("\tR") : _T("\t_"));
-	StringCchCat(sz1, MAXSZ1, HIWORD(lParam) & KF_ALTDOWN ? _T("\tA") : _T("\t_"));
-	StringCchCat(sz1, MAXSZ1, HIWORD(lParam) & KF_MENUMODE ? _T("\tM") : _T("\t_"));
-	StringCchCat(sz1, MAXSZ1, HIWORD(lParam) & KF_DLGMODE ? _T("\tD") : _T("\t_"));
-	StringCchCat(sz1, MAXSZ1, HIWORD(lParam) & KF_EXTENDED ? _T("\tX") : _T("\t_"));
-
-	#define MAXSZ2 15
-	TCHAR sz2[MAXSZ2];
-	WORD scanCode = LOBYTE(HIWORD(lParam));
-	if (HIWORD(lParam) & KF_EXTENDED) scanCode = MAKEWORD(scanCode, 0xE0);
-	StringCchPrintf(sz2, MAXSZ2, _T("\tSC:  0x%04X"), scanCode);
-	StringCchCat(sz1, MAXSZ1, sz2);
-
-	#define MAXSZ3 15
-	TCHAR sz3[MAXSZ3];
-	StringCchPrintf(sz3, MAXSZ3, _T("\tRC:  0x%04X"), LOWORD(lParam));
-	StringCchCat(sz1, MAXSZ1, sz3);
-
-	return sz1;
+	if (!bFrozen || !frozen.isValid() || frozen.Last() == 0)
+	{
+		ShowScrollBar(hWnd, SB_VERT, false);
+		return;
+	}
+
+	SCROLLINFO si;
+	si.cbSize = sizeof(si);
+	si.fMask = SIF_ALL | SIF_DISABLENOSCROLL;
+	si.nMin = 0;
+	si.nMax = frozen.Last() - frozen.First() + MAX_MESSAGES - 1;
+	si.nPage = MAX_MESSAGES;
+	si.nPos = frozen.Last() - frozenTop;
+	si.nTrackPos = 0;
+	ShowScrollBar(hWnd, SB_VERT, true);
+	SetScrollInfo(hWnd, SB_VERT, &si, true);
 }
 
 
 
 //
-//  FUNCTION: MouseButtons(WPARAM)
+//  FUNCTION: Freeze(HWND, UINT)
 //
-//  PURPOSE: Decodes wParam in a WM_MOUSEMOVE message - Helper to the paint procedure
+//  PURPOSE: Freezes the display on a new snapshot of the history, with the top row at a
+//           sequence number, or at the newest message when it is 0 or past the newest
 //
+void Freeze(HWND hWnd, UINT top)
+{
+	DrainCapturedEvents(hWnd);
+	frozen = history.Snapshot();
+	frozenTop = top && top < frozen.Last() ? top : frozen.Last();
+	bFrozen = true;
+	SetFrozenScroll(hWnd);
+	CheckMenuItem(GetMenu(hWnd), ID_VIEW_FREEZE, MF_CHECKED);
+	InvalidateRect(hWnd, NULL, true);
+}
 
-const TCHAR* MouseButtons(WPARAM wParam)
+
+
+//
+//  FUNCTION: SaveCapture(HWND)
+//
+//  PURPOSE: Saves the history to a capture file chosen by the user, for KeyboardMouseAnalyzer
+//
+BOOL SaveCapture(HWND hWnd)
 {
-	#define MAXSZ4 16
-	static TCHAR sz[MAXSZ4];
-	StringCchCopy(sz, MAXSZ4, _T(""));
-
-	StringCchCat(sz, MAXSZ4, wParam & MK_XBUTTON2 /* 0x0040 */ ? _T("2") : _T("_"));
-	StringCchCat(sz, MAXSZ4, wParam & MK_XBUTTON1 /* 0x0020 */ ? _T("\t1") : _T("\t_"));
-	StringCchCat(sz, MAXSZ4, wParam & MK_MBUTTON  /* 0x0010 */ ? _T("\tM") : _T("\t_"));
-	StringCchCat(sz, MAXSZ4, wParam & MK_CONTROL  /* 0x0008 */ ? _T("\tC") : _T("\t_"));
-	StringCchCat(sz, MAXSZ4, wParam & MK_SHIFT    /* 0x0004 */ ? _T("\tS") : _T("\t_"));
-	StringCchCat(sz, MAXSZ4, wParam & MK_RBUTTON  /* 0x0002 */ ? _T("\tR") : _T("\t_"));
-	StringCchCat(sz, MAXSZ4, wParam & MK_LBUTTON  /* 0x0001 */ ? _T("\tL") : _T("\t_"));
-
-	return sz;
+	TCHAR szPath[MAX_PATH] = _T("KeyboardMouseMonitor.kmc");
+	OPENFILENAME ofn;
+	ZeroMemory(&ofn, sizeof(ofn));
+	ofn.lStructSize = sizeof(ofn);
+	ofn.hwndOwner = hWnd;
+	ofn.lpstrFilter = _T("Capture Files (*.kmc)\0*.kmc\0All Files (*.*)\0*.*\0");
+	ofn.lpstrFile = szPath;
+	ofn.nMaxFile = MAX_PATH;
+	ofn.lpstrDefExt = _T("kmc");
+	ofn.Flags = OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST;
+	if (!GetSaveFileName(&ofn)) return false;
+
+	DrainCapturedEvents(hWnd);
+	CaptureWriter writer;
+	BOOL bOK = writer.Open(szPath);
+	EventRecord er;
+	for (UINT sequence = history.First(); bOK && sequence && sequence <= history.Last(); sequence++)
+	{
+		if (history.Get(sequence, &er)) bOK = writer.Write(er);
+	}
+	if (!writer.Close()) bOK = false;
+	if (!bOK)
+	{
+		MessageBox(hWnd, _T("ERROR: Unable to save the capture!"), szTitle, MB_OK | MB_ICONSTOP);
+	}
+	return bOK;
+}
+
+
+
+//
+//  FUNCTION: PaintHeatMap(HWND, HDC)
+//
+//  PURPOSE: Renders the heat map, one pixel per cell, stretched over the client area
+//
+void PaintHeatMap(HWND hWnd, HDC hdc)
+{
+	UINT cxCells = heatMap.CellsX();
+	UINT cyCells = heatMap.CellsY();
+	if (cxCells == 0 || cyCells == 0) return;
+
+	DWORD* pPixels = new DWORD[cxCells * cyCells];
+	heatMap.Render(pPixels);
+
+	BITMAPINFO bmi;
+	ZeroMemory(&bmi, sizeof(bmi));
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = cxCells;
+	bmi.bmiHeader.biHeight = -(LONG)cyCells; // Top row first
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+
+	RECT rc;
+	GetClientRect(hWnd, &rc);
+	SetStretchBltMode(hdc, COLORONCOLOR);
+	StretchDIBits(hdc, 0, 0, rc.right, rc.bottom, 0, 0, cxCells, cyCells,
+		pPixels, &bmi, DIB_RGB_COLORS, SRCCOPY);
+
+	delete[] pPixels;
 }
 
 
@@ -602,3 +1190,35 @@ INT_PTR CALLBACK About(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam)
 	}
 	return (INT_PTR)FALSE;
 }
+
+
+
+// Message handler for the find typed text box.
+INT_PTR CALLBACK FindTyped(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam)
+{
+	UNREFERENCED_PARAMETER(lParam);
+	switch (message)
+	{
+	case WM_INITDIALOG:
+		SetDlgItemText(hDlg, IDC_FINDTEXT, szFind);
+		SendDlgItemMessage(hDlg, IDC_FINDTEXT, EM_LIMITTEXT, MAX_QUERY_LEN, 0);
+		return (INT_PTR)TRUE;
+
+	case WM_COMMAND:
+		if (LOWORD(wParam) == IDOK)
+		{
+			// Find from the start again when the text changed
+			TCHAR szText[MAX_QUERY_LEN + 1];
+			GetDlgItemText(hDlg, IDC_FINDTEXT, szText, MAX_QUERY_LEN + 1);
+			if (lstrcmp(szText, szFind) != 0) findFrom = 0;
+			StringCchCopy(szFind, MAX_QUERY_LEN + 1, szText);
+		}
+		if (LOWORD(wParam) == IDOK || LOWORD(wParam) == IDCANCEL)
+		{
+			EndDialog(hDlg, LOWORD(wParam));
+			return (INT_PTR)TRUE;
+		}
+		break;
+	}
+	return (INT_PTR)FALSE;
+}
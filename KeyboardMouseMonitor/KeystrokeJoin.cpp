@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// KeystrokeJoin.cpp : Provides the joining of key downs, characters and key ups into keystrokes.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "KeystrokeJoin.h"
+#include "EventMerger.h"
+#include "PatternDetector.h"
+
+static_assert(KEYSTROKE_SOURCES == MAX_SOURCES, "Every capture source has its keystrokes joined");
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+KeystrokeJoin::KeystrokeJoin()
+{
+	Reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Forget the keystrokes in flight and the modifiers held
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void KeystrokeJoin::Reset()
+{
+	ZeroMemory(_inflight, sizeof(_inflight));
+	memset(_slotOf, NO_INFLIGHT, sizeof(_slotOf));
+	for (UINT i = 0; i < MAX_INFLIGHT_KEYS; i++) _freeSlot[i] = (BYTE)(MAX_INFLIGHT_KEYS - 1 - i);
+	_cFree = MAX_INFLIGHT_KEYS;
+	ZeroMemory(_modifiers, sizeof(_modifiers));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The extended scan code of a keyboard message, with the 0xE0 prefix folded into bit 8
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT KeystrokeJoin::KeyIndex(LPARAM lParam)
+{
+	return LOBYTE(HIWORD(lParam)) | (HIWORD(lParam) & KF_EXTENDED ? 0x100 : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Take a key out of flight - Its slot keeps the keystroke until it is reused
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void KeystrokeJoin::End(UINT source, UINT key)
+{
+	_freeSlot[_cFree++] = _slotOf[source][key];
+	_slotOf[source][key] = NO_INFLIGHT;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Join a recorded message - Returns a KEYSTROKE_* value, and for all but KEYSTROKE_NONE the
+// keystroke in *ppKeystroke, valid until the next call
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT KeystrokeJoin::OnEvent(const EventRecord& er, Keystroke** ppKeystroke)
+{
+	*ppKeystroke = NULL;
+	if (er.source >= KEYSTROKE_SOURCES) return KEYSTROKE_NONE;
+	UINT source = er.source;
+	UINT key = KeyIndex(er.lParam);
+	UINT slot = _slotOf[source][key];
+
+	switch (er.message)
+	{
+	case WM_KEYDOWN:
+	case WM_SYSKEYDOWN:
+	{
+		// Autorepeat of the key in flight
+		UINT modifier = PatternDetector::ModifierOf(er.wParam);
+		if (slot != NO_INFLIGHT && (HIWORD(er.lParam) & KF_REPEAT))
+		{
+			Keystroke& ks = _inflight[slot];
+			ks.cRepeats++;
+			ks.lastSequence = er.sequence;
+			*ppKeystroke = &ks;
+			return KEYSTROKE_UPDATED;
+		}
+
+		// A new press, ending the one in flight whose key up was never seen
+		if (slot != NO_INFLIGHT) End(source, key);
+		if (_cFree == 0)
+		{
+			_modifiers[source] |= modifier;
+			return KEYSTROKE_NONE;
+		}
+		slot = _freeSlot[--_cFree];
+		_slotOf[source][key] = (BYTE)slot;
+
+		Keystroke& ks = _inflight[slot];
+		ks.down = er;
+		ks.cRepeats = 0;
+		ks.cChars = 0;
+		ks.ch = 0;
+		ks.modifiers = _modifiers[source] & ~modifier;
+		ks.lastSequence = er.sequence;
+		ks.upTimestamp = 0;
+		ks.row = 0;
+		_modifiers[source] |= modifier;
+		*ppKeystroke = &ks;
+		return KEYSTROKE_STARTED;
+	}
+	case WM_CHAR:
+	case WM_SYSCHAR:
+	case WM_DEADCHAR:
+	case WM_SYSDEADCHAR:
+	{
+		if (slot == NO_INFLIGHT) return KEYSTROKE_NONE;
+		Keystroke& ks = _inflight[slot];
+		if (ks.cChars++ == 0) ks.ch = (TCHAR)er.wParam;
+		ks.lastSequence = er.sequence;
+		*ppKeystroke = &ks;
+		return KEYSTROKE_UPDATED;
+	}
+	case WM_KEYUP:
+	case WM_SYSKEYUP:
+	{
+		_modifiers[source] &= ~PatternDetector::ModifierOf(er.wParam);
+		if (slot == NO_INFLIGHT) return KEYSTROKE_NONE;
+		Keystroke& ks = _inflight[slot];
+		ks.upTimestamp = er.timestamp > ks.down.timestamp ? er.timestamp : ks.down.timestamp + 1;
+		ks.lastSequence = er.sequence;
+		End(source, key);
+		*ppKeystroke = &ks;
+		return KEYSTROKE_ENDED;
+	}
+	default:
+		return KEYSTROKE_NONE;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "framework.h"
+#include "EventRecord.h"
+
+#define MAX_INFLIGHT_KEYS 16                // Keys held down at once that can be joined
+#define KEYSTROKE_KEYS 512                  // Extended scan codes, the 0xE0 prefix folded into bit 8
+#define KEYSTROKE_SOURCES 64                // Capture sources joined, MAX_SOURCES
+#define NO_INFLIGHT 0xFF
+
+// Result of KeystrokeJoin::OnEvent()
+#define KEYSTROKE_NONE 0                    // Not joined, the message stands on its own
+#define KEYSTROKE_STARTED 1                 // A key down started a keystroke
+#define KEYSTROKE_UPDATED 2                 // An autorepeat or a character was joined to a keystroke
+#define KEYSTROKE_ENDED 3                   // The key up ended a keystroke
+
+// One keystroke: its key down, autorepeat, the characters it produced and its key up
+struct Keystroke
+{
+	EventRecord down;                       // The key down, the raw messages follow it in the history
+	UINT        cRepeats;                   // Autorepeated key downs
+	UINT        cChars;                     // Characters produced, dead characters included
+	TCHAR       ch;                         // The first character produced, 0 for none
+	UINT        modifiers;                  // MOD_* held when the key went down
+	UINT        lastSequence;               // The newest message joined
+	ULONGLONG   upTimestamp;                // 0 while the key is held
+	UINT        row;                        // Left to the caller, DisplayRows keeps its row number here
+};
+
+// Joins the keyboard messages of each key press into one keystroke, as they are recorded.
+//
+// The keystrokes in flight - key down, key up not yet seen - are kept in a small fixed
+// table, found through an index by capture source and extended scan code, so joining a
+// message is O(1) and never allocates. Each source is a keyboard of its own: the raw input
+// of a keyboard repeats the key presses of the main window, and the load generator threads
+// interleave theirs, so neither may end the keystroke of another source. Characters are
+// joined by the scan code in their lParam, which is that of the key that produced them.
+// Messages that join no keystroke in flight, such as a key up whose key down came before
+// Reset(), the keys beyond MAX_INFLIGHT_KEYS held at once, or the sources from
+// KEYSTROKE_SOURCES on, are left on their own. The raw messages are untouched in the
+// EventHistory.
+class KeystrokeJoin
+{
+private:
+	Keystroke _inflight[MAX_INFLIGHT_KEYS];
+	BYTE      _slotOf[KEYSTROKE_SOURCES][KEYSTROKE_KEYS]; // Source and extended scan code to slot,
+	                                                      // NO_INFLIGHT for none
+	BYTE      _freeSlot[MAX_INFLIGHT_KEYS]; // Stack of the free slots
+	UINT      _cFree;
+	UINT      _modifiers[KEYSTROKE_SOURCES]; // MOD_* of the modifier keys held down, per source
+
+	static UINT KeyIndex(LPARAM lParam);
+	void End(UINT source, UINT key);
+public:
+	KeystrokeJoin();
+	void Reset();
+	UINT OnEvent(const EventRecord& er, Keystroke** ppKeystroke);
+	UINT InFlight() const { return MAX_INFLIGHT_KEYS - _cFree; }
+};
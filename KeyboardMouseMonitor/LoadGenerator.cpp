@@ -0,0 +1,423 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// LoadGenerator.cpp : Provides a synthetic input load generator for stress-testing the capture,
+//                     recording and formatting path.
+//
+//                     Each worker thread composes gestures (drags, key-repeat storms, chords,
+//                     clicks, wheel runs, Alt and dead key combinations) from a seeded random
+//                     stream, and pushes them to its own capture queue at a fixed rate or as
+//                     fast as possible.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "LoadGenerator.h"
+
+#include <chrono>
+
+// Keys used by the keyboard gestures, with their set 1 scan codes and characters
+static const struct
+{
+	BYTE  vk;
+	BYTE  scanCode;
+	TCHAR ch;
+} keys[] =
+{
+	{ 'A', 0x1E, 'a' }, { 'B', 0x30, 'b' }, { 'C', 0x2E, 'c' }, { 'D', 0x20, 'd' },
+	{ 'E', 0x12, 'e' }, { 'F', 0x21, 'f' }, { 'G', 0x22, 'g' }, { 'H', 0x23, 'h' },
+	{ 'I', 0x17, 'i' }, { 'J', 0x24, 'j' }, { 'K', 0x25, 'k' }, { 'L', 0x26, 'l' },
+	{ 'M', 0x32, 'm' }, { 'N', 0x31, 'n' }, { 'O', 0x18, 'o' }, { 'P', 0x19, 'p' },
+	{ 'Q', 0x10, 'q' }, { 'R', 0x13, 'r' }, { 'S', 0x1F, 's' }, { 'T', 0x14, 't' },
+	{ 'U', 0x16, 'u' }, { 'V', 0x2F, 'v' }, { 'W', 0x11, 'w' }, { 'X', 0x2D, 'x' },
+	{ 'Y', 0x15, 'y' }, { 'Z', 0x2C, 'z' }, { '1', 0x02, '1' }, { '2', 0x03, '2' },
+	{ '3', 0x04, '3' }, { '4', 0x05, '4' }, { '5', 0x06, '5' }, { '6', 0x07, '6' },
+	{ '7', 0x08, '7' }, { '8', 0x09, '8' }, { '9', 0x0A, '9' }, { '0', 0x0B, '0' },
+	{ VK_SPACE, 0x39, ' ' }, { VK_RETURN, 0x1C, '\r' }, { VK_BACK, 0x0E, '\b' },
+};
+#define SCAN_CONTROL 0x1D
+#define SCAN_SHIFT   0x2A
+#define SCAN_MENU    0x38
+#define SCAN_QUOTE   0x28   // VK_OEM_7, a dead key on international layouts
+
+// Extended (0xE0 prefixed) keys without a character
+static const struct
+{
+	BYTE vk;
+	BYTE scanCode;
+} extendedKeys[] =
+{
+	{ VK_UP, 0x48 }, { VK_DOWN, 0x50 }, { VK_LEFT, 0x4B }, { VK_RIGHT, 0x4D },
+	{ VK_HOME, 0x47 }, { VK_END, 0x4F }, { VK_PRIOR, 0x49 }, { VK_NEXT, 0x51 },
+	{ VK_INSERT, 0x52 }, { VK_DELETE, 0x53 },
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Fill in the weights and rates of a predefined load
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LoadConfigProfile(LoadConfig* pConfig, LoadProfile profile)
+{
+	ZeroMemory(pConfig, sizeof(LoadConfig));
+	pConfig->cThreads = 1;
+	pConfig->seed = 0x9E3779B97F4A7C15ULL;
+
+	switch (profile)
+	{
+	case LOAD_PROFILE_MOUSE8K:
+		pConfig->weight[LOAD_DRAG] = 1;
+		pConfig->eventsPerSecond = 8000;
+		break;
+	case LOAD_PROFILE_KEYREPEAT:
+		pConfig->weight[LOAD_KEYREPEAT] = 1;
+		break;
+	case LOAD_PROFILE_CHORDS:
+		pConfig->weight[LOAD_CHORD] = 3;
+		pConfig->weight[LOAD_SYSKEY] = 1;
+		break;
+	case LOAD_PROFILE_MIXED:
+	default:
+		pConfig->weight[LOAD_DRAG] = 4;
+		pConfig->weight[LOAD_KEYREPEAT] = 2;
+		pConfig->weight[LOAD_CHORD] = 2;
+		pConfig->weight[LOAD_CLICK] = 3;
+		pConfig->weight[LOAD_WHEEL] = 2;
+		pConfig->weight[LOAD_SYSKEY] = 1;
+		pConfig->weight[LOAD_DEADKEY] = 1;
+		break;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Helpers that encode messages as the system does
+///////////////////////////////////////////////////////////////////////////////////////////////////
+static ULONGLONG NextRandom(ULONGLONG& state)
+{
+	// xorshift64* - the same sequence on every platform and compiler
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 0x2545F4914F6CDD1DULL;
+}
+
+static UINT RandomBelow(ULONGLONG& state, UINT n)
+{
+	return (UINT)((NextRandom(state) >> 32) % n);
+}
+
+static LPARAM KeyLParam(BYTE scanCode, WORD flags)
+{
+	return (LPARAM)(DWORD)MAKELONG(1, scanCode | flags);
+}
+
+static void Key(EventRecord* per, UINT& n, UINT message, WPARAM wParam, BYTE scanCode, WORD flags)
+{
+	per[n].message = message;
+	per[n].wParam = wParam;
+	per[n].lParam = KeyLParam(scanCode, flags);
+	n++;
+}
+
+static void Mouse(EventRecord* per, UINT& n, UINT message, WPARAM wParam, int x, int y)
+{
+	per[n].message = message;
+	per[n].wParam = wParam;
+	per[n].lParam = MAKELPARAM(x, y);
+	n++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Compose one gesture - Returns the number of records written to per
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT LoadGenerator::Gesture(const LoadConfig& config, ULONGLONG& random, UINT source, EventRecord* per)
+{
+	// Pick a gesture by weight
+	UINT total = 0;
+	for (UINT i = 0; i < LOAD_PATTERNS; i++) total += config.weight[i];
+	if (total == 0) return 0;
+	UINT pick = RandomBelow(random, total);
+	UINT pattern = 0;
+	while (pick >= config.weight[pattern]) pick -= config.weight[pattern++];
+
+	UINT n = 0;
+	int x = (int)RandomBelow(random, 1920);
+	int y = (int)RandomBelow(random, 1080);
+
+	switch (pattern)
+	{
+	case LOAD_DRAG:
+	{
+		// A straight drag with a little jitter, one move per device report
+		UINT cMoves = 50 + RandomBelow(random, 400);
+		int dx = (int)RandomBelow(random, 7) - 3;
+		int dy = (int)RandomBelow(random, 7) - 3;
+		Mouse(per, n, WM_LBUTTONDOWN, MK_LBUTTON, x, y);
+		for (UINT i = 0; i < cMoves; i++)
+		{
+			x += dx + (int)RandomBelow(random, 3) - 1;
+			y += dy + (int)RandomBelow(random, 3) - 1;
+			Mouse(per, n, WM_MOUSEMOVE, MK_LBUTTON, x, y);
+		}
+		Mouse(per, n, WM_LBUTTONUP, 0, x, y);
+	}
+	break;
+
+	case LOAD_KEYREPEAT:
+	{
+		// A held key: the first WM_KEYDOWN, then autorepeat with the previous state bit set
+		UINT k = RandomBelow(random, ARRAYSIZE(keys));
+		UINT cRepeats = 20 + RandomBelow(random, 200);
+		for (UINT i = 0; i <= cRepeats; i++)
+		{
+			WORD flags = i ? KF_REPEAT : 0;
+			Key(per, n, WM_KEYDOWN, keys[k].vk, keys[k].scanCode, flags);
+			Key(per, n, WM_CHAR, (WPARAM)keys[k].ch, keys[k].scanCode, flags);
+		}
+		Key(per, n, WM_KEYUP, keys[k].vk, keys[k].scanCode, KF_REPEAT | KF_UP);
+	}
+	break;
+
+	case LOAD_CHORD:
+	{
+		// Ctrl+Shift+letter produces the control character, Ctrl+Shift+extended key produces none
+		Key(per, n, WM_KEYDOWN, VK_CONTROL, SCAN_CONTROL, 0);
+		Key(per, n, WM_KEYDOWN, VK_SHIFT, SCAN_SHIFT, 0);
+		if (RandomBelow(random, 2))
+		{
+			UINT k = RandomBelow(random, 26);
+			Key(per, n, WM_KEYDOWN, keys[k].vk, keys[k].scanCode, 0);
+			Key(per, n, WM_CHAR, (WPARAM)(keys[k].vk - 'A' + 1), keys[k].scanCode, 0);
+			Key(per, n, WM_KEYUP, keys[k].vk, keys[k].scanCode, KF_REPEAT | KF_UP);
+		}
+		else
+		{
+			UINT k = RandomBelow(random, ARRAYSIZE(extendedKeys));
+			Key(per, n, WM_KEYDOWN, extendedKeys[k].vk, extendedKeys[k].scanCode, KF_EXTENDED);
+			Key(per, n, WM_KEYUP, extendedKeys[k].vk, extendedKeys[k].scanCode, KF_EXTENDED | KF_REPEAT | KF_UP);
+		}
+		Key(per, n, WM_KEYUP, VK_SHIFT, SCAN_SHIFT, KF_REPEAT | KF_UP);
+		Key(per, n, WM_KEYUP, VK_CONTROL, SCAN_CONTROL, KF_REPEAT | KF_UP);
+	}
+	break;
+
+	case LOAD_CLICK:
+	{
+		// One of the five buttons, sometimes double clicked
+		static const struct { UINT down, up, dblclk; WORD mk, xbutton; } buttons[] =
+		{
+			{ WM_LBUTTONDOWN, WM_LBUTTONUP, WM_LBUTTONDBLCLK, MK_LBUTTON,  0        },
+			{ WM_RBUTTONDOWN, WM_RBUTTONUP, WM_RBUTTONDBLCLK, MK_RBUTTON,  0        },
+			{ WM_MBUTTONDOWN, WM_MBUTTONUP, WM_MBUTTONDBLCLK, MK_MBUTTON,  0        },
+			{ WM_XBUTTONDOWN, WM_XBUTTONUP, WM_XBUTTONDBLCLK, MK_XBUTTON1, XBUTTON1 },
+			{ WM_XBUTTONDOWN, WM_XBUTTONUP, WM_XBUTTONDBLCLK, MK_XBUTTON2, XBUTTON2 },
+		};
+		UINT b = RandomBelow(random, ARRAYSIZE(buttons));
+		WORD modifiers = RandomBelow(random, 4) == 0 ? MK_CONTROL : 0;
+		Mouse(per, n, buttons[b].down, MAKEWPARAM(buttons[b].mk | modifiers, buttons[b].xbutton), x, y);
+		Mouse(per, n, buttons[b].up, MAKEWPARAM(modifiers, buttons[b].xbutton), x, y);
+		if (RandomBelow(random, 3) == 0)
+		{
+			Mouse(per, n, buttons[b].dblclk, MAKEWPARAM(buttons[b].mk | modifiers, buttons[b].xbutton), x, y);
+			Mouse(per, n, buttons[b].up, MAKEWPARAM(modifiers, buttons[b].xbutton), x, y);
+		}
+	}
+	break;
+
+	case LOAD_WHEEL:
+	{
+		// A run of notches in one direction, as a free-spinning wheel produces
+		UINT cNotches = 1 + RandomBelow(random, 40);
+		short delta = RandomBelow(random, 2) ? WHEEL_DELTA : -WHEEL_DELTA;
+		for (UINT i = 0; i < cNotches; i++)
+		{
+			Mouse(per, n, WM_MOUSEWHEEL, MAKEWPARAM(0, delta), x, y);
+		}
+	}
+	break;
+
+	case LOAD_SYSKEY:
+	{
+		// Alt+key, sometimes Alt+dead key
+		Key(per, n, WM_SYSKEYDOWN, VK_MENU, SCAN_MENU, KF_ALTDOWN);
+		if (RandomBelow(random, 4))
+		{
+			UINT k = RandomBelow(random, ARRAYSIZE(keys));
+			Key(per, n, WM_SYSKEYDOWN, keys[k].vk, keys[k].scanCode, KF_ALTDOWN);
+			Key(per, n, WM_SYSCHAR, (WPARAM)keys[k].ch, keys[k].scanCode, KF_ALTDOWN);
+			Key(per, n, WM_SYSKEYUP, keys[k].vk, keys[k].scanCode, KF_ALTDOWN | KF_REPEAT | KF_UP);
+		}
+		else
+		{
+			Key(per, n, WM_SYSKEYDOWN, VK_OEM_7, SCAN_QUOTE, KF_ALTDOWN);
+			Key(per, n, WM_SYSDEADCHAR, (WPARAM)'\'', SCAN_QUOTE, KF_ALTDOWN);
+			Key(per, n, WM_SYSKEYUP, VK_OEM_7, SCAN_QUOTE, KF_ALTDOWN | KF_REPEAT | KF_UP);
+		}
+		Key(per, n, WM_KEYUP, VK_MENU, SCAN_MENU, KF_REPEAT | KF_UP);
+	}
+	break;
+
+	case LOAD_DEADKEY:
+	{
+		// ' then e composes e acute
+		Key(per, n, WM_KEYDOWN, VK_OEM_7, SCAN_QUOTE, 0);
+		Key(per, n, WM_DEADCHAR, (WPARAM)'\'', SCAN_QUOTE, 0);
+		Key(per, n, WM_KEYUP, VK_OEM_7, SCAN_QUOTE, KF_REPEAT | KF_UP);
+		Key(per, n, WM_KEYDOWN, 'E', 0x12, 0);
+		Key(per, n, WM_CHAR, (WPARAM)0x00E9, 0x12, 0);
+		Key(per, n, WM_KEYUP, 'E', 0x12, KF_REPEAT | KF_UP);
+	}
+	break;
+	}
+
+	for (UINT i = 0; i < n; i++)
+	{
+		per[i].sequence = 0;
+		per[i].timestamp = 0;
+		per[i].source = source;
+	}
+	return n;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+LoadGenerator::LoadGenerator()
+{
+	_pMerger = NULL;
+	ZeroMemory(&_config, sizeof(_config));
+	for (UINT i = 0; i < MAX_LOAD_THREADS; i++)
+	{
+		_worker[i].pOwner = this;
+		_worker[i].pQueue = NULL;
+		_worker[i].source = 0;
+		_worker[i].generated.store(0);
+		_worker[i].dropped.store(0);
+	}
+	_cWorkers = 0;
+	_cRunning = 0;
+	_bStop.store(false);
+	_startTime = 0;
+	_stopTime = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Destructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+LoadGenerator::~LoadGenerator()
+{
+	Stop();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Start the worker threads, each with its own capture source
+// The queues are created on the first start and reused afterwards
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL LoadGenerator::Start(EventMerger* pMerger, const LoadConfig& config)
+{
+	if (_cRunning) return false;
+	if (_pMerger != pMerger) _cWorkers = 0;
+	_pMerger = pMerger;
+	_config = config;
+	if (_config.cThreads == 0) _config.cThreads = 1;
+	if (_config.cThreads > MAX_LOAD_THREADS) _config.cThreads = MAX_LOAD_THREADS;
+
+	while (_cWorkers < _config.cThreads)
+	{
+		_worker[_cWorkers].pQueue = _pMerger->AddSource(LOAD_QUEUE_CAPACITY, &_worker[_cWorkers].source);
+		if (_worker[_cWorkers].pQueue == NULL) break;
+		_cWorkers++;
+	}
+	if (_cWorkers < _config.cThreads) _config.cThreads = _cWorkers;
+	if (_config.cThreads == 0) return false;
+
+	_bStop.store(false);
+	_startTime = EventTimestamp();
+	for (UINT i = 0; i < _config.cThreads; i++)
+	{
+		_worker[i].generated.store(0);
+		_worker[i].dropped.store(0);
+		_worker[i].pQueue->Open(_startTime);
+		_worker[i].thread = std::thread(Run, &_worker[i], i);
+	}
+	_cRunning = _config.cThreads;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Stop the worker threads and close their queues
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LoadGenerator::Stop()
+{
+	if (_cRunning == 0) return;
+
+	_bStop.store(true);
+	for (UINT i = 0; i < _cRunning; i++)
+	{
+		_worker[i].thread.join();
+		_worker[i].pQueue->Close();
+	}
+	_stopTime = EventTimestamp();
+	_cRunning = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Totals over all worker threads
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LoadGenerator::GetStats(LoadStats* pStats)
+{
+	pStats->generated = 0;
+	pStats->dropped = 0;
+	for (UINT i = 0; i < _config.cThreads; i++)
+	{
+		pStats->generated += _worker[i].generated.load(std::memory_order_relaxed);
+		pStats->dropped += _worker[i].dropped.load(std::memory_order_relaxed);
+	}
+	pStats->seconds = ((_cRunning ? EventTimestamp() : _stopTime) - _startTime) / 1e6;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Worker thread
+// At a fixed rate each record is stamped with its scheduled time and the records that are
+// due are pushed together, so the thread sleeps between batches instead of spinning.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void LoadGenerator::Run(Worker* pWorker, UINT index)
+{
+	LoadGenerator* pOwner = pWorker->pOwner;
+	const LoadConfig& config = pOwner->_config;
+	ULONGLONG random = config.seed + 0x9E3779B97F4A7C15ULL * (index + 1);
+	if (random == 0) random = 1;
+
+	EventRecord gesture[MAX_GESTURE_LEN];
+	UINT cGesture = 0, iGesture = 0;
+	ULONGLONG generated = 0, dropped = 0;
+	ULONGLONG start = pOwner->_startTime;
+
+	while (!pOwner->_bStop.load(std::memory_order_relaxed))
+	{
+		// Work out how many records are due now
+		ULONGLONG now = EventTimestamp();
+		ULONGLONG cDue = 256;
+		if (config.eventsPerSecond)
+		{
+			ULONGLONG scheduled = (now - start) * config.eventsPerSecond / 1000000;
+			cDue = scheduled > generated ? scheduled - generated : 0;
+			if (cDue == 0)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+		}
+
+		for (ULONGLONG i = 0; i < cDue; i++)
+		{
+			if (iGesture == cGesture)
+			{
+				cGesture = Gesture(config, random, pWorker->source, gesture);
+				iGesture = 0;
+				if (cGesture == 0) return;
+			}
+			EventRecord& er = gesture[iGesture++];
+			er.timestamp = config.eventsPerSecond ? start + generated * 1000000 / config.eventsPerSecond : now;
+			if (!pWorker->pQueue->Push(er)) dropped++;
+			generated++;
+		}
+		pWorker->generated.store(generated, std::memory_order_relaxed);
+		pWorker->dropped.store(dropped, std::memory_order_relaxed);
+	}
+}
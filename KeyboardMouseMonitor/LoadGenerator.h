@@ -0,0 +1,87 @@
+#pragma once
+#include "framework.h"
+#include "EventMerger.h"
+
+#include <atomic>
+#include <thread>
+
+#define MAX_LOAD_THREADS 16
+#define LOAD_QUEUE_CAPACITY 65536
+#define MAX_GESTURE_LEN 1024            // Longest burst of messages generated at once
+
+// Gestures the generator composes its load from
+enum LoadPattern
+{
+	LOAD_DRAG,          // Button down, a run of WM_MOUSEMOVE, button up
+	LOAD_KEYREPEAT,     // Held key: WM_KEYDOWN/WM_CHAR with KF_REPEAT, then WM_KEYUP
+	LOAD_CHORD,         // Ctrl+Shift+key with its control character
+	LOAD_CLICK,         // Single and double clicks of all five buttons
+	LOAD_WHEEL,         // Runs of WM_MOUSEWHEEL notches
+	LOAD_SYSKEY,        // Alt+key: WM_SYSKEYDOWN, WM_SYSCHAR/WM_SYSDEADCHAR, WM_SYSKEYUP
+	LOAD_DEADKEY,       // Dead key accent: WM_DEADCHAR followed by the composed WM_CHAR
+	LOAD_PATTERNS
+};
+
+// Predefined loads
+enum LoadProfile
+{
+	LOAD_PROFILE_MOUSE8K,       // 8 kHz mouse drags
+	LOAD_PROFILE_KEYREPEAT,     // Key-repeat storm at full speed
+	LOAD_PROFILE_CHORDS,        // Mixed chords and Alt combinations
+	LOAD_PROFILE_MIXED          // Every gesture, every message type
+};
+
+struct LoadConfig
+{
+	UINT      weight[LOAD_PATTERNS];    // Relative frequency of each gesture
+	UINT      eventsPerSecond;          // Per thread, 0 runs as fast as possible
+	UINT      cThreads;
+	ULONGLONG seed;                     // Same seed, same load
+};
+
+struct LoadStats
+{
+	ULONGLONG generated;    // Records offered to the capture queues
+	ULONGLONG dropped;      // Records refused because a queue was full
+	double    seconds;      // Time since Start()
+};
+
+void LoadConfigProfile(LoadConfig* pConfig, LoadProfile profile);
+
+// Emits reproducible synthetic input on one or more threads, each thread feeding its own
+// capture source of an EventMerger. The wParam/lParam of every record are encoded as the
+// system would encode them, so the load exercises the same decoding and formatting paths.
+class LoadGenerator
+{
+private:
+	struct Worker
+	{
+		LoadGenerator*         pOwner;
+		EventQueue*            pQueue;
+		UINT                   source;
+		std::thread            thread;
+		std::atomic<ULONGLONG> generated;
+		std::atomic<ULONGLONG> dropped;
+	};
+
+	EventMerger*      _pMerger;
+	LoadConfig        _config;
+	Worker            _worker[MAX_LOAD_THREADS];
+	UINT              _cWorkers;            // Workers that have a queue, kept across restarts
+	UINT              _cRunning;
+	std::atomic<bool> _bStop;
+	ULONGLONG         _startTime;
+	ULONGLONG         _stopTime;
+
+	static void Run(Worker* pWorker, UINT index);
+public:
+	// Compose one gesture of at most MAX_GESTURE_LEN records, without sequence or timestamp
+	static UINT Gesture(const LoadConfig& config, ULONGLONG& random, UINT source, EventRecord* per);
+
+	LoadGenerator();
+	~LoadGenerator();
+	BOOL Start(EventMerger* pMerger, const LoadConfig& config);
+	void Stop();
+	BOOL isRunning() { return _cRunning != 0; }
+	void GetStats(LoadStats* pStats);
+};
@@ -0,0 +1,287 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// MessageFormat.cpp : Provides the formatting of the displayed rows, one formatter per event class.
+//
+//                     The rows are assembled piece by piece into the caller's buffer, with the
+//                     lengths of the names taken from the message table, so formatting a row
+//                     needs neither a format string to be parsed nor the result to be measured.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "MessageFormat.h"
+#include "KeyNames.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Appends pieces of a row to a buffer, truncating at its end
+///////////////////////////////////////////////////////////////////////////////////////////////////
+class RowWriter
+{
+private:
+	TCHAR* _p;
+	TCHAR* _pEnd;                           // Last character of the buffer, kept for the terminator
+	TCHAR* _pStart;
+public:
+	RowWriter(TCHAR* psz, size_t cch) { _pStart = _p = psz; _pEnd = psz + (cch ? cch - 1 : 0); }
+	size_t Finish() { if (_p <= _pEnd) *_p = 0; return _p - _pStart; }
+
+	void Char(TCHAR ch) { if (_p < _pEnd) *_p++ = ch; }
+	void Text(const TCHAR* psz, size_t cch) { while (cch-- && _p < _pEnd) *_p++ = *psz++; }
+	template <size_t N> void Literal(const TCHAR (&sz)[N]) { Text(sz, N - 1); }
+
+	// Like %0*u
+	void Decimal(UINT value, UINT width)
+	{
+		TCHAR digits[10];
+		UINT cDigits = 0;
+		do { digits[cDigits++] = (TCHAR)(_T('0') + value % 10); value /= 10; } while (value);
+		while (width > cDigits) { Char(_T('0')); width--; }
+		while (cDigits) Char(digits[--cDigits]);
+	}
+
+	// Like %+0*d, the width including the sign
+	void Signed(int value, UINT width)
+	{
+		Char(value < 0 ? _T('-') : _T('+'));
+		Decimal(value < 0 ? 0u - (UINT)value : (UINT)value, width > 1 ? width - 1 : 0);
+	}
+
+	// Like %0*llX
+	void Hex(ULONGLONG value, UINT digits)
+	{
+		while (digits--) Char(_T("0123456789ABCDEF")[(value >> (digits * 4)) & 0xF]);
+	}
+
+	// The U R A M D X flags, scan code and repeat count of a keyboard message
+	void ExtendedStatus(LPARAM lParam)
+	{
+		WORD flags = HIWORD(lParam);
+		Char(flags & KF_UP ? _T('U') : _T('_'));
+		Char(_T('\t')); Char(flags & KF_REPEAT ? _T('R') : _T('_'));
+		Char(_T('\t')); Char(flags & KF_ALTDOWN ? _T('A') : _T('_'));
+		Char(_T('\t')); Char(flags & KF_MENUMODE ? _T('M') : _T('_'));
+		Char(_T('\t')); Char(flags & KF_DLGMODE ? _T('D') : _T('_'));
+		Char(_T('\t')); Char(flags & KF_EXTENDED ? _T('X') : _T('_'));
+
+		Literal(_T("\tSC:  0x"));
+		Hex(ExtendedScanCode(lParam), 4);
+		Literal(_T("\tRC:  0x"));
+		Hex(LOWORD(lParam), 4);
+	}
+
+	// The names of the key, by scan code and, for key downs and ups, by virtual key code
+	void Key(const EventRecord& er)
+	{
+		const KeyName& scanName = ScanCodeName(ExtendedScanCode(er.lParam));
+		Text(scanName.pszName, scanName.cchName);
+		if (er.message == WM_KEYDOWN || er.message == WM_KEYUP ||
+			er.message == WM_SYSKEYDOWN || er.message == WM_SYSKEYUP)
+		{
+			const KeyName& vkName = VirtualKeyName((UINT)er.wParam);
+			if (scanName.cchName && vkName.cchName) Literal(_T("  "));
+			Text(vkName.pszName, vkName.cchName);
+		}
+	}
+
+	// The 2 1 M C S R L flags of a mouse message
+	void MouseButtons(WPARAM wParam)
+	{
+		Char(wParam & MK_XBUTTON2 /* 0x0040 */ ? _T('2') : _T('_'));
+		Char(_T('\t')); Char(wParam & MK_XBUTTON1 /* 0x0020 */ ? _T('1') : _T('_'));
+		Char(_T('\t')); Char(wParam & MK_MBUTTON  /* 0x0010 */ ? _T('M') : _T('_'));
+		Char(_T('\t')); Char(wParam & MK_CONTROL  /* 0x0008 */ ? _T('C') : _T('_'));
+		Char(_T('\t')); Char(wParam & MK_SHIFT    /* 0x0004 */ ? _T('S') : _T('_'));
+		Char(_T('\t')); Char(wParam & MK_RBUTTON  /* 0x0002 */ ? _T('R') : _T('_'));
+		Char(_T('\t')); Char(wParam & MK_LBUTTON  /* 0x0001 */ ? _T('L') : _T('_'));
+	}
+
+	// "Sequence:  99999999\tMessage:  AAAAAAAAAAAAAAAA", the start of every row
+	void Head(const EventRecord& er)
+	{
+		const MessageDescriptor& md = DescribeMessage(er.message);
+		Literal(_T("Sequence:  "));
+		Decimal(er.sequence, 8);
+		Literal(_T("\tMessage:  "));
+		Text(md.pszName, md.cchName);
+	}
+
+	// "\tPoint:  (+9999,+9999)\tVKeyStatus:  "
+	void Point(LPARAM lParam)
+	{
+		Literal(_T("\tPoint:  ("));
+		Signed(GET_X_LPARAM(lParam), 5);
+		Char(_T(','));
+		Signed(GET_Y_LPARAM(lParam), 5);
+		Literal(_T(")\tVKeyStatus:  "));
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Not a captured message - Nothing to display
+///////////////////////////////////////////////////////////////////////////////////////////////////
+template <> size_t FormatRowAs<EVENT_NONE>(TCHAR* psz, size_t cch, const EventRecord& er)
+{
+	UNREFERENCED_PARAMETER(er);
+	if (cch) psz[0] = 0;
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Keyboard message - usage: up to 159 out of 175
+///////////////////////////////////////////////////////////////////////////////////////////////////
+template <> size_t FormatRowAs<EVENT_KEYBOARD>(TCHAR* psz, size_t cch, const EventRecord& er)
+{
+	RowWriter w(psz, cch);
+	w.Head(er);
+	w.Literal(_T("\tExt:  "));
+	w.ExtendedStatus(er.lParam);
+	w.Literal(_T("\twParam:  0x"));
+	w.Hex(er.wParam, 16);
+	w.Literal(_T("\tKey:  "));
+	w.Key(er);
+	w.Literal(_T("\t "));
+	return w.Finish();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Mouse move message - usage: 94 out of 175
+///////////////////////////////////////////////////////////////////////////////////////////////////
+template <> size_t FormatRowAs<EVENT_MOUSEMOVE>(TCHAR* psz, size_t cch, const EventRecord& er)
+{
+	RowWriter w(psz, cch);
+	w.Head(er);
+	w.Point(er.lParam);
+	w.MouseButtons(GET_KEYSTATE_WPARAM(er.wParam));
+	w.Literal(_T("\t "));
+	return w.Finish();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Mouse wheel message - usage: 109 out of 175
+///////////////////////////////////////////////////////////////////////////////////////////////////
+template <> size_t FormatRowAs<EVENT_MOUSEWHEEL>(TCHAR* psz, size_t cch, const EventRecord& er)
+{
+	RowWriter w(psz, cch);
+	w.Head(er);
+	w.Point(er.lParam);
+	w.MouseButtons(GET_KEYSTATE_WPARAM(er.wParam));
+	w.Literal(_T("\tWheel:  "));
+	w.Signed(GET_WHEEL_DELTA_WPARAM(er.wParam), 5);
+	w.Literal(_T("\t "));
+	return w.Finish();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Mouse click message - usage: 96 out of 175
+///////////////////////////////////////////////////////////////////////////////////////////////////
+template <> size_t FormatRowAs<EVENT_MOUSECLICK>(TCHAR* psz, size_t cch, const EventRecord& er)
+{
+	RowWriter w(psz, cch);
+	w.Head(er);
+	w.Point(er.lParam);
+	w.MouseButtons(er.wParam);
+	w.Literal(_T("\t "));
+	return w.Finish();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Format the row of a message with the formatter of its class - Returns the length
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t FormatRow(TCHAR* psz, size_t cch, const EventRecord& er)
+{
+	return DescribeMessage(er.message).pFormat(psz, cch, er);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Format a folded run of key autorepeat - Returns the length, usage: 110 out of 175
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t FormatFoldedRow(TCHAR* psz, size_t cch, const DisplayRow& row)
+{
+	const EventRecord& er = row.er;
+	double seconds = (row.lastTimestamp - er.timestamp) / 1e6;
+	TCHAR* pszEnd = psz;
+	StringCchPrintfEx(psz, cch, &pszEnd, NULL, 0,
+		_T("Sequence:  %08d\tMessage:  %s\tRepeats:  %u\tChars:  %u\tRate:  %.1f/s\tLast:  %08d\t "),
+		er.sequence, GetMessageText(er.message), row.cRepeats, row.cChars,
+		seconds > 0 ? (row.cRepeats - 1) / seconds : 0.0, row.lastSequence);
+	return pszEnd - psz;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Format a keystroke joined from its messages - Returns the length, usage: up to 145 out of 175
+///////////////////////////////////////////////////////////////////////////////////////////////////
+size_t FormatKeystrokeRow(TCHAR* psz, size_t cch, const DisplayRow& row)
+{
+	RowWriter w(psz, cch);
+	w.Literal(_T("Sequence:  "));
+	w.Decimal(row.er.sequence, 8);
+	w.Literal(_T("\tKeystroke:  "));
+	w.Key(row.er);
+
+	// The character, control characters as ^X
+	w.Literal(_T("\tChar:  "));
+	if (row.ch && (row.ch < 0x20 || row.ch == 0x7F))
+	{
+		w.Char(_T('^'));
+		w.Char(row.ch == 0x7F ? _T('?') : (TCHAR)(row.ch + 0x40));
+	}
+	else if (row.ch) w.Char(row.ch);
+
+	w.Literal(_T("\tMods:  "));
+	w.Char(row.modifiers & MOD_CONTROL ? _T('C') : _T('_'));
+	w.Char(row.modifiers & MOD_SHIFT ? _T('S') : _T('_'));
+	w.Char(row.modifiers & MOD_ALT ? _T('A') : _T('_'));
+	w.Char(row.modifiers & MOD_WIN ? _T('W') : _T('_'));
+
+	// Tenths of milliseconds from the key down to the key up
+	w.Literal(_T("\tHeld:  "));
+	if (row.upTimestamp)
+	{
+		ULONGLONG tenths = (row.upTimestamp - row.er.timestamp) / 100;
+		if (tenths > 999999) tenths = 999999;
+		w.Decimal((UINT)(tenths / 10), 1);
+		w.Char(_T('.'));
+		w.Decimal((UINT)(tenths % 10), 1);
+		w.Literal(_T(" ms"));
+	}
+	else w.Literal(_T("down"));
+
+	w.Literal(_T("\tRepeats:  "));
+	w.Decimal(row.cRepeats, 1);
+	w.Literal(_T("\tLast:  "));
+	w.Decimal(row.lastSequence, 8);
+	w.Literal(_T("\t "));
+	return w.Finish();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Decode the message type
+///////////////////////////////////////////////////////////////////////////////////////////////////
+const TCHAR* GetMessageText(UINT message)
+{
+	return DescribeMessage(message).pszName;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Decode lParam in a keyboard message
+///////////////////////////////////////////////////////////////////////////////////////////////////
+const TCHAR* GetExtendedStatus(LPARAM lParam)
+{
+	#define MAXSZ1 42
+	static TCHAR sz1[MAXSZ1];
+	RowWriter w(sz1, MAXSZ1);
+	w.ExtendedStatus(lParam);
+	w.Finish();
+	return sz1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Decode wParam in a mouse message
+///////////////////////////////////////////////////////////////////////////////////////////////////
+const TCHAR* MouseButtons(WPARAM wParam)
+{
+	#define MAXSZ4 16
+	static TCHAR sz[MAXSZ4];
+	RowWriter w(sz, MAXSZ4);
+	w.MouseButtons(wParam);
+	w.Finish();
+	return sz;
+}
@@ -0,0 +1,217 @@
+#pragma once
+#include "framework.h"
+#include "EventRecord.h"
+#include "DisplayRows.h"
+
+// Event classes - Messages of a class are formatted alike
+#define EVENT_NONE 0                        // Not a captured message
+#define EVENT_KEYBOARD 1
+#define EVENT_MOUSEMOVE 2
+#define EVENT_MOUSEWHEEL 3
+#define EVENT_MOUSECLICK 4
+
+#define MAX_TAB_STOPS 16
+
+// The tab stops of a row, in units of the widest character of the font
+struct RowLayout
+{
+	int  tabStop[MAX_TAB_STOPS];
+	UINT cTabStops;
+};
+
+constexpr RowLayout layoutNone = { { 0 }, 0 };
+constexpr RowLayout layoutKeyboard =
+{ {                                         // "Sequence:  99999999"
+	 24,                                    // "\tMessage:  AAAAAAAAAAAAAAAA"
+	 52,                                    // "\tExt:  "
+	 58,                                    // "\tU"            (Up)
+	 60,                                    // "\tR"            (Repeat)
+	 62,                                    // "\tA"            (Alt)
+	 64,                                    // "\tM"            (Menu)
+	 66,                                    // "\tD"            (Dialog)
+	 68,                                    // "\tX"            (Extended)
+	 74,                                    // "\tSC:  0xFFFF"  (Scan Code)
+	 90,                                    // "\tRC:  0xFFFF"  (Repeat Count)
+	105,                                    // "\twParam:  0xFFFFFFFFFFFFFFFF"
+	134,                                    // "\tKey:  Num Enter  VK_RETURN"
+	170                                     // "\t "
+}, 13 };
+constexpr RowLayout layoutMouseMove =
+{ {                                         // "Sequence:  99999999"
+	 24,                                    // "\tMessage:  AAAAAAAAAAAAAAAA"
+	 55,                                    // "\tPoint:  (+9999,+9999)"
+	 79,                                    // "\tVKeyStatus:"
+	 92,                                    // "\t2"
+	 94,                                    // "\t1"
+	 96,                                    // "\tM"
+	 98,                                    // "\tC"
+	100,                                    // "\tS"
+	102,                                    // "\tR"
+	104,                                    // "\tL"
+	150                                     // "\t "
+}, 11 };
+constexpr RowLayout layoutMouseWheel =
+{ {                                         // "Sequence:  99999999"
+	 24,                                    // "\tMessage:  AAAAAAAAAAAAAAAA"
+	 55,                                    // "\tPoint:  (+9999,+9999)"
+	 79,                                    // "\tVKeyStatus:"
+	 92,                                    // "\t2"
+	 94,                                    // "\t1"
+	 96,                                    // "\tM"
+	 98,                                    // "\tC"
+	100,                                    // "\tS"
+	102,                                    // "\tR"
+	104,                                    // "\tL"
+	109,                                    // "\tWheel:  +"
+	118,                                    // "\t9999"
+	150                                     // "\t "
+}, 13 };
+constexpr RowLayout layoutMouseClick = layoutMouseMove;
+constexpr RowLayout layoutRepeat =
+{ {                                         // "Sequence:  99999999"
+	 24,                                    // "\tMessage:  AAAAAAAAAAAAAAAA"
+	 55,                                    // "\tRepeats:  99999"
+	 75,                                    // "\tChars:  99999"
+	 93,                                    // "\tRate:  999.9/s"
+	111,                                    // "\tLast:  99999999"
+	150                                     // "\t "
+}, 6 };
+constexpr RowLayout layoutKeystroke =
+{ {                                         // "Sequence:  99999999"
+	 24,                                    // "\tKeystroke:  Num Enter  VK_RETURN"
+	 72,                                    // "\tChar:  ^X"
+	 84,                                    // "\tMods:  CSAW"
+	 98,                                    // "\tHeld:  99999.9 ms"
+	120,                                    // "\tRepeats:  99999"
+	138,                                    // "\tLast:  99999999"
+	156                                     // "\t "
+}, 7 };
+
+// Formats the row of a message - Returns the length
+typedef size_t (*RowFormatter)(TCHAR* psz, size_t cch, const EventRecord& er);
+
+// One formatter per event class, specialized in MessageFormat.cpp
+template <UINT eventClass> size_t FormatRowAs(TCHAR* psz, size_t cch, const EventRecord& er);
+template <> size_t FormatRowAs<EVENT_NONE>(TCHAR* psz, size_t cch, const EventRecord& er);
+template <> size_t FormatRowAs<EVENT_KEYBOARD>(TCHAR* psz, size_t cch, const EventRecord& er);
+template <> size_t FormatRowAs<EVENT_MOUSEMOVE>(TCHAR* psz, size_t cch, const EventRecord& er);
+template <> size_t FormatRowAs<EVENT_MOUSEWHEEL>(TCHAR* psz, size_t cch, const EventRecord& er);
+template <> size_t FormatRowAs<EVENT_MOUSECLICK>(TCHAR* psz, size_t cch, const EventRecord& er);
+
+// Everything about a message that displaying it takes
+struct MessageDescriptor
+{
+	UINT             message;
+	const TCHAR*     pszName;
+	UINT             cchName;
+	UINT             eventClass;
+	const RowLayout* pLayout;
+	RowFormatter     pFormat;
+};
+
+#define DESCRIBE(message, eventClass, layout) \
+	{ message, _T(#message), sizeof(#message) - 1, eventClass, &layout, FormatRowAs<eventClass> }
+
+// The captured messages, indexed by MessageSlot() - A new message type is one more row, in any
+// place, and the slots and the lookup follow from the table
+constexpr MessageDescriptor messageTable[] =
+{
+	DESCRIBE(WM_KEYDOWN,       EVENT_KEYBOARD,   layoutKeyboard),   // 0x0100
+	DESCRIBE(WM_KEYUP,         EVENT_KEYBOARD,   layoutKeyboard),   // 0x0101
+	DESCRIBE(WM_CHAR,          EVENT_KEYBOARD,   layoutKeyboard),   // 0x0102
+	DESCRIBE(WM_DEADCHAR,      EVENT_KEYBOARD,   layoutKeyboard),   // 0x0103
+	DESCRIBE(WM_SYSKEYDOWN,    EVENT_KEYBOARD,   layoutKeyboard),   // 0x0104
+	DESCRIBE(WM_SYSKEYUP,      EVENT_KEYBOARD,   layoutKeyboard),   // 0x0105
+	DESCRIBE(WM_SYSCHAR,       EVENT_KEYBOARD,   layoutKeyboard),   // 0x0106
+	DESCRIBE(WM_SYSDEADCHAR,   EVENT_KEYBOARD,   layoutKeyboard),   // 0x0107
+
+	DESCRIBE(WM_MOUSEMOVE,     EVENT_MOUSEMOVE,  layoutMouseMove),  // 0x0200
+	DESCRIBE(WM_LBUTTONDOWN,   EVENT_MOUSECLICK, layoutMouseClick), // 0x0201
+	DESCRIBE(WM_LBUTTONUP,     EVENT_MOUSECLICK, layoutMouseClick), // 0x0202
+	DESCRIBE(WM_LBUTTONDBLCLK, EVENT_MOUSECLICK, layoutMouseClick), // 0x0203
+	DESCRIBE(WM_RBUTTONDOWN,   EVENT_MOUSECLICK, layoutMouseClick), // 0x0204
+	DESCRIBE(WM_RBUTTONUP,     EVENT_MOUSECLICK, layoutMouseClick), // 0x0205
+	DESCRIBE(WM_RBUTTONDBLCLK, EVENT_MOUSECLICK, layoutMouseClick), // 0x0206
+	DESCRIBE(WM_MBUTTONDOWN,   EVENT_MOUSECLICK, layoutMouseClick), // 0x0207
+	DESCRIBE(WM_MBUTTONUP,     EVENT_MOUSECLICK, layoutMouseClick), // 0x0208
+	DESCRIBE(WM_MBUTTONDBLCLK, EVENT_MOUSECLICK, layoutMouseClick), // 0x0209
+	DESCRIBE(WM_MOUSEWHEEL,    EVENT_MOUSEWHEEL, layoutMouseWheel), // 0x020A
+	DESCRIBE(WM_XBUTTONDOWN,   EVENT_MOUSECLICK, layoutMouseClick), // 0x020B
+	DESCRIBE(WM_XBUTTONUP,     EVENT_MOUSECLICK, layoutMouseClick), // 0x020C
+	DESCRIBE(WM_XBUTTONDBLCLK, EVENT_MOUSECLICK, layoutMouseClick)  // 0x020D
+};
+constexpr MessageDescriptor messageUnknown = { 0, _T("NOT_FOUND"), 9, EVENT_NONE, &layoutNone, FormatRowAs<EVENT_NONE> };
+
+#define MESSAGE_SLOTS ((UINT)ARRAYSIZE(messageTable))
+
+// A run of table rows whose messages are consecutive
+struct MessageRange
+{
+	UINT first;                             // Message of the first row
+	UINT cMessages;
+	UINT slot;                              // Slot of the first row
+};
+
+constexpr UINT CountMessageRanges()
+{
+	UINT cRanges = 0;
+	for (UINT slot = 0; slot < MESSAGE_SLOTS; slot++)
+	{
+		if (slot == 0 || messageTable[slot].message != messageTable[slot - 1].message + 1) cRanges++;
+	}
+	return cRanges;
+}
+
+#define MESSAGE_RANGES CountMessageRanges()
+
+struct MessageRanges
+{
+	MessageRange range[MESSAGE_RANGES];
+};
+
+// The runs of messageTable, built when compiling
+constexpr MessageRanges MakeMessageRanges()
+{
+	MessageRanges ranges = {};
+	UINT cRanges = 0;
+	for (UINT slot = 0; slot < MESSAGE_SLOTS; slot++)
+	{
+		if (cRanges && messageTable[slot].message == messageTable[slot - 1].message + 1) ranges.range[cRanges - 1].cMessages++;
+		else ranges.range[cRanges++] = MessageRange{ messageTable[slot].message, 1, slot };
+	}
+	return ranges;
+}
+
+constexpr MessageRanges messageRanges = MakeMessageRanges();
+
+// The table slot of a message, -1 if it is not a captured message
+constexpr int MessageSlot(UINT message)
+{
+	for (const MessageRange& range : messageRanges.range)
+	{
+		if (message - range.first < range.cMessages) return (int)(range.slot + message - range.first);
+	}
+	return -1;
+}
+
+constexpr const MessageDescriptor& DescribeMessage(UINT message)
+{
+	return MessageSlot(message) < 0 ? messageUnknown : messageTable[MessageSlot(message)];
+}
+
+constexpr BOOL MessageTableUnique()
+{
+	for (UINT slot = 0; slot < MESSAGE_SLOTS; slot++)
+	{
+		if (MessageSlot(messageTable[slot].message) != (int)slot) return false;
+	}
+	return true;
+}
+static_assert(MessageTableUnique(), "messageTable must list each message once");
+
+const TCHAR* GetMessageText(UINT message);
+const TCHAR* GetExtendedStatus(LPARAM lParam);
+const TCHAR* MouseButtons(WPARAM wParam);
+size_t FormatRow(TCHAR* psz, size_t cch, const EventRecord& er);
+size_t FormatFoldedRow(TCHAR* psz, size_t cch, const DisplayRow& row);
+size_t FormatKeystrokeRow(TCHAR* psz, size_t cch, const DisplayRow& row);
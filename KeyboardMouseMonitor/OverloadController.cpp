@@ -0,0 +1,153 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// OverloadController.cpp : Provides the overload controller, which sheds input in stages.
+//
+//                          Without it the window falls behind under a heavy load, since every
+//                          message shifts the rows and paints synchronously. With it the lag of
+//                          the newest message stays bounded, and every shed message is counted.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "OverloadController.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+OverloadController::OverloadController()
+{
+	Reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Return to no shedding, and clear the counts
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void OverloadController::Reset()
+{
+	_level = SHED_NONE;
+	_calmSince = 0;
+	_sample = 0;
+	_peakLag = 0;
+	_late = 0;
+	ZeroMemory(_shed, sizeof(_shed));
+	ZeroMemory(_dropped, sizeof(_dropped));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Step the level up or down after a drain, given the messages still queued and how far
+// behind the newest recorded message was
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void OverloadController::Update(UINT depth, ULONGLONG lag, ULONGLONG now)
+{
+	if (lag > _peakLag) _peakLag = lag;
+
+	if (depth > OVERLOAD_DEPTH_HIGH || lag > OVERLOAD_LAG_HIGH)
+	{
+		if (_level < SHED_SAMPLE) _level++;
+		_calmSince = 0;
+	}
+	else if (depth < OVERLOAD_DEPTH_LOW && lag < OVERLOAD_LAG_LOW)
+	{
+		if (_calmSince == 0) _calmSince = now;
+		else if (_level > SHED_NONE && now - _calmSince >= OVERLOAD_CALM)
+		{
+			_level--;
+			_calmSince = now;
+		}
+	}
+	else
+	{
+		_calmSince = 0;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Returns whether to record the message - Counts it as shed if not. Only moves are sampled,
+// clicks and the wheel are few and are all recorded, so no button down loses its up
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL OverloadController::Sample(UINT message)
+{
+	if (_level < SHED_SAMPLE || message != WM_MOUSEMOVE) return true;
+	if (++_sample % SHED_SAMPLE_RATE == 0) return true;
+
+	Shed(SHED_SAMPLE, message);
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Count a message shed at a level
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void OverloadController::Shed(UINT level, UINT message)
+{
+	int slot = MessageSlot(message);
+	if (level < SHED_LEVELS && slot >= 0) _shed[level][slot]++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Count the records lost to the capture queues - pDropped holds MESSAGE_SLOTS + 1 counts,
+// by MessageSlot() then all others, see EventMerger::TakeDropped()
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void OverloadController::Lost(const ULONGLONG* pDropped, ULONGLONG late)
+{
+	for (UINT slot = 0; slot <= MESSAGE_SLOTS; slot++) _dropped[slot] += pDropped[slot];
+	_late += late;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The count of a message type shed at a level
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ULONGLONG OverloadController::Shed(UINT level, UINT message) const
+{
+	int slot = MessageSlot(message);
+	return level < SHED_LEVELS && slot >= 0 ? _shed[level][slot] : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The count of all messages shed at a level
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ULONGLONG OverloadController::ShedAt(UINT level) const
+{
+	ULONGLONG total = 0;
+	for (UINT slot = 0; level < SHED_LEVELS && slot < MESSAGE_SLOTS; slot++) total += _shed[level][slot];
+	return total;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The count of a message type that was not recorded, coalesced or sampled out
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ULONGLONG OverloadController::NotRecorded(UINT message) const
+{
+	return Shed(SHED_COALESCE, message) + Shed(SHED_SAMPLE, message);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The count of a message type dropped by the capture queues, 0 for types outside MessageSlot()
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ULONGLONG OverloadController::Dropped(UINT message) const
+{
+	int slot = MessageSlot(message);
+	return slot >= 0 ? _dropped[slot] : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The count of all records dropped by the capture queues
+///////////////////////////////////////////////////////////////////////////////////////////////////
+ULONGLONG OverloadController::Dropped() const
+{
+	ULONGLONG total = 0;
+	for (UINT slot = 0; slot <= MESSAGE_SLOTS; slot++) total += _dropped[slot];
+	return total;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The name of a level
+///////////////////////////////////////////////////////////////////////////////////////////////////
+const TCHAR* OverloadController::LevelText(UINT level)
+{
+	switch (level)
+	{
+	case SHED_NONE:     return _T("none");
+	case SHED_COALESCE: return _T("coalescing moves");
+	case SHED_NOFORMAT: return _T("formatting newest rows only");
+	case SHED_SAMPLE:   return _T("sampling mouse");
+	}
+	return _T("");
+}
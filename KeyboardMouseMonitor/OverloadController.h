@@ -0,0 +1,56 @@
+#pragma once
+#include "framework.h"
+#include "MessageFormat.h"
+
+// Shedding levels, each one includes the ones below it
+#define SHED_NONE 0
+#define SHED_COALESCE 1                     // Consecutive moves of a source are coalesced into the last one
+#define SHED_NOFORMAT 2                     // Messages are recorded but only the newest rows are formatted
+#define SHED_SAMPLE 3                       // Only one in SHED_SAMPLE_RATE mouse moves is recorded
+#define SHED_LEVELS 4
+
+#define SHED_SAMPLE_RATE 8
+#define OVERLOAD_DEPTH_HIGH 8192            // Queued messages that mean overload
+#define OVERLOAD_DEPTH_LOW 1024
+#define OVERLOAD_LAG_HIGH 100000            // Microseconds behind, past the reorder window, that mean overload
+#define OVERLOAD_LAG_LOW 20000
+#define OVERLOAD_CALM 1000000               // Microseconds below the low marks before stepping down a level
+
+// Decides how much of the input to shed when it arrives faster than it can be recorded and
+// displayed, and counts exactly what was shed, per level and per message type. It also counts
+// what was lost before the shedding could help: the records the capture queues dropped when
+// full, per message type, and those merged late, out of timestamp order.
+//
+// The level steps up by one on every update that sees the queue depth or the lag of the
+// newest recorded message above the high marks, and steps down by one after both have
+// stayed below the low marks for OVERLOAD_CALM. Only mouse moves are ever sampled out, the
+// keyboard, the buttons and the wheel are always recorded.
+class OverloadController
+{
+private:
+	UINT      _level;
+	ULONGLONG _calmSince;                   // When both marks were last seen low, 0 if not calm
+	UINT      _sample;                      // Counts mouse moves for sampling
+	ULONGLONG _shed[SHED_LEVELS][MESSAGE_SLOTS]; // Indexed by MessageSlot()
+	ULONGLONG _dropped[MESSAGE_SLOTS + 1];  // By MessageSlot(), then all others
+	ULONGLONG _late;
+	ULONGLONG _peakLag;
+public:
+	OverloadController();
+	void Reset();
+	void Update(UINT depth, ULONGLONG lag, ULONGLONG now);
+	BOOL Sample(UINT message);
+	void Shed(UINT level, UINT message);
+	void Lost(const ULONGLONG* pDropped, ULONGLONG late);
+
+	UINT Level() const { return _level; }
+	ULONGLONG PeakLag() const { return _peakLag; }
+	ULONGLONG Shed(UINT level, UINT message) const;
+	ULONGLONG ShedAt(UINT level) const;
+	ULONGLONG NotRecorded(UINT message) const;
+	ULONGLONG Dropped(UINT message) const;
+	ULONGLONG Dropped() const;
+	ULONGLONG Late() const { return _late; }
+
+	static const TCHAR* LevelText(UINT level);
+};
@@ -0,0 +1,301 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// PatternDetector.cpp : Provides a streaming detector of key press patterns - hotkey chords,
+//                       forbidden sequences, or scan code sequences typed within a time limit.
+//
+//                       Many rules are compiled into one Aho-Corasick automaton so that
+//                       matching costs O(1) per key press regardless of the number of rules.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "PatternDetector.h"
+
+#include <stdio.h>
+
+#define NO_STATE ((UINT)-1)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+PatternDetector::PatternDetector()
+{
+	_cClasses = 0;
+	_isCompiled = false;
+	Reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Restart matching, forgetting the keys seen so far
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void PatternDetector::Reset()
+{
+	_state = 0;
+	_modifiers = 0;
+	_cPressed = 0;
+	ZeroMemory(_time, sizeof(_time));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Continue matching after the given key presses, oldest first, without reporting their matches
+// Only the last MAX_PATTERN_LEN presses can be part of a match, so they restore the state exactly.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void PatternDetector::Resume(const KeySymbol* pSymbols, const ULONGLONG* pTimes, UINT cSymbols, UINT modifiers)
+{
+	Reset();
+	_modifiers = modifiers;
+	if (!_isCompiled) return;
+
+	UINT first = cSymbols > MAX_PATTERN_LEN ? cSymbols - MAX_PATTERN_LEN : 0;
+	for (UINT i = first; i < cSymbols; i++)
+	{
+		_state = _next[_state * _cClasses + _classOf[pSymbols[i]]];
+		_time[_cPressed++ & (MAX_PATTERN_LEN - 1)] = pTimes[i];
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The MOD_ flag of a modifier key, or 0 for other keys
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT PatternDetector::ModifierOf(WPARAM vk)
+{
+	switch (vk)
+	{
+	case VK_CONTROL: case VK_LCONTROL: case VK_RCONTROL: return MOD_CONTROL;
+	case VK_SHIFT:   case VK_LSHIFT:   case VK_RSHIFT:   return MOD_SHIFT;
+	case VK_MENU:    case VK_LMENU:    case VK_RMENU:    return MOD_ALT;
+	case VK_LWIN:    case VK_RWIN:                       return MOD_WIN;
+	}
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Add a rule from its key symbols - The rule takes effect at the next Compile()
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL PatternDetector::AddRule(const KeySymbol* pSymbols, UINT cSymbols, UINT windowMs, const TCHAR* pszText)
+{
+	if (cSymbols == 0 || cSymbols > MAX_PATTERN_LEN) return false;
+
+	Rule rule;
+	for (UINT i = 0; i < cSymbols; i++) rule.symbol[i] = pSymbols[i];
+	rule.cSymbols = cSymbols;
+	rule.window = (ULONGLONG)windowMs * 1000;
+	StringCchCopy(rule.szText, MAX_RULE_TEXT, pszText ? pszText : _T(""));
+	_rules.push_back(rule);
+	_isCompiled = false;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Add a rule from its text, see PatternDetector.h for the syntax
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL PatternDetector::AddRule(const TCHAR* pszRule)
+{
+	static const struct
+	{
+		const TCHAR* pszName;
+		size_t       cchName;
+		UINT         modifier;
+	} modifiers[] =
+	{
+		{ _T("Ctrl+"),  5, MOD_CONTROL },
+		{ _T("Shift+"), 6, MOD_SHIFT   },
+		{ _T("Alt+"),   4, MOD_ALT     },
+		{ _T("Win+"),   4, MOD_WIN     },
+	};
+
+	KeySymbol symbol[MAX_PATTERN_LEN];
+	UINT cSymbols = 0;
+	UINT windowMs = 0;
+
+	const TCHAR* p = pszRule;
+	for (;;)
+	{
+		while (*p == _T(' ') || *p == _T('\t')) p++;
+		if (*p == 0) break;
+
+		// Modifiers
+		UINT mods = 0;
+		BOOL bFound = true;
+		while (bFound)
+		{
+			bFound = false;
+			for (UINT i = 0; i < ARRAYSIZE(modifiers); i++)
+			{
+				if (_tcsnicmp(p, modifiers[i].pszName, modifiers[i].cchName) == 0)
+				{
+					mods |= modifiers[i].modifier;
+					p += modifiers[i].cchName;
+					bFound = true;
+				}
+			}
+		}
+
+		// Key scan code, or the time limit
+		TCHAR* pEnd;
+		ULONG value = _tcstoul(p, &pEnd, 0);
+		if (pEnd == p) return false;
+		if (mods == 0 && _tcsnicmp(pEnd, _T("ms"), 2) == 0)
+		{
+			windowMs = value;
+			p = pEnd + 2;
+			continue;
+		}
+		if (windowMs || cSymbols == MAX_PATTERN_LEN || value > 0xE0FF) return false;
+		if (value > 0xFF && HIBYTE(value) != 0xE0) return false;
+		symbol[cSymbols++] = MAKEKEYSYMBOL(value, mods);
+		p = pEnd;
+	}
+
+	return AddRule(symbol, cSymbols, windowMs, pszRule);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Add the rules of a text file, one per line - Blank lines and lines starting with ; are skipped
+// Returns the number of rules added
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT PatternDetector::LoadRules(const TCHAR* pszPath)
+{
+	FILE* pFile = NULL;
+	if (_tfopen_s(&pFile, pszPath, _T("r")) != 0 || pFile == NULL) return 0;
+
+	UINT cAdded = 0;
+	TCHAR szLine[MAX_RULE_TEXT];
+	while (_fgetts(szLine, MAX_RULE_TEXT, pFile))
+	{
+		size_t cch = _tcslen(szLine);
+		while (cch && (szLine[cch - 1] == _T('\n') || szLine[cch - 1] == _T('\r') || szLine[cch - 1] == _T(' '))) szLine[--cch] = 0;
+		if (cch == 0 || szLine[0] == _T(';')) continue;
+		if (AddRule(szLine)) cAdded++;
+	}
+	fclose(pFile);
+	return cAdded;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Build the automaton from the rules
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void PatternDetector::Compile()
+{
+	// Give each key symbol used by a rule its own column
+	_classOf.assign(KEYSYMBOL_COUNT, 0);
+	_cClasses = 1;
+	for (const Rule& rule : _rules)
+	{
+		for (UINT i = 0; i < rule.cSymbols; i++)
+		{
+			if (_classOf[rule.symbol[i]] == 0) _classOf[rule.symbol[i]] = _cClasses++;
+		}
+	}
+
+	// Build the trie, one table row per state
+	_next.assign(_cClasses, NO_STATE);
+	std::vector<std::vector<UINT>> own(1);
+	for (UINT r = 0; r < (UINT)_rules.size(); r++)
+	{
+		UINT state = 0;
+		for (UINT i = 0; i < _rules[r].cSymbols; i++)
+		{
+			UINT column = _classOf[_rules[r].symbol[i]];
+			if (_next[state * _cClasses + column] == NO_STATE)
+			{
+				UINT newState = (UINT)(_next.size() / _cClasses);
+				_next.resize(_next.size() + _cClasses, NO_STATE);
+				own.resize(newState + 1);
+				_next[state * _cClasses + column] = newState;
+			}
+			state = _next[state * _cClasses + column];
+		}
+		own[state].push_back(r);
+	}
+	UINT cStates = (UINT)(_next.size() / _cClasses);
+
+	// Breadth first: complete the transitions through the failure links and collect
+	// the rules that end in each state, including those ending in its failure states
+	std::vector<UINT> fail(cStates, 0);
+	std::vector<std::vector<UINT>> out(cStates);
+	std::vector<UINT> queue;
+	queue.reserve(cStates);
+	for (UINT c = 0; c < _cClasses; c++)
+	{
+		UINT& next = _next[c];
+		if (next == NO_STATE) next = 0;
+		else queue.push_back(next);
+	}
+	out[0] = own[0];
+	for (size_t head = 0; head < queue.size(); head++)
+	{
+		UINT state = queue[head];
+		out[state] = own[state];
+		out[state].insert(out[state].end(), out[fail[state]].begin(), out[fail[state]].end());
+
+		for (UINT c = 0; c < _cClasses; c++)
+		{
+			UINT& next = _next[state * _cClasses + c];
+			UINT viaFail = _next[fail[state] * _cClasses + c];
+			if (next == NO_STATE)
+			{
+				next = viaFail;
+			}
+			else
+			{
+				fail[next] = viaFail;
+				queue.push_back(next);
+			}
+		}
+	}
+
+	// Flatten the match lists
+	_outFirst.assign(cStates + 1, 0);
+	_out.clear();
+	for (UINT s = 0; s < cStates; s++)
+	{
+		_outFirst[s] = (UINT)_out.size();
+		_out.insert(_out.end(), out[s].begin(), out[s].end());
+	}
+	_outFirst[cStates] = (UINT)_out.size();
+
+	_isCompiled = true;
+	Reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Feed one recorded message - Returns the number of matches written to pMatches
+// Modifier keys only update the modifier state, and autorepeat does not count as a key press.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT PatternDetector::OnEvent(const EventRecord& er, PatternMatch* pMatches, UINT cMaxMatches)
+{
+	if (!_isCompiled) return 0;
+
+	BOOL isDown = er.message == WM_KEYDOWN || er.message == WM_SYSKEYDOWN;
+	BOOL isUp = er.message == WM_KEYUP || er.message == WM_SYSKEYUP;
+	if (!isDown && !isUp) return 0;
+
+	UINT modifier = ModifierOf(er.wParam);
+	if (modifier)
+	{
+		if (isDown) _modifiers |= modifier;
+		else        _modifiers &= ~modifier;
+		return 0;
+	}
+	if (isUp || (HIWORD(er.lParam) & KF_REPEAT)) return 0;
+
+	// One transition per key press
+	WORD scanCode = LOBYTE(HIWORD(er.lParam));
+	if (HIWORD(er.lParam) & KF_EXTENDED) scanCode = MAKEWORD(scanCode, 0xE0);
+	_state = _next[_state * _cClasses + _classOf[MAKEKEYSYMBOL(scanCode, _modifiers)]];
+	_time[_cPressed++ & (MAX_PATTERN_LEN - 1)] = er.timestamp;
+
+	// Report the rules that end here and were typed fast enough
+	UINT cMatches = 0;
+	for (UINT i = _outFirst[_state]; i < _outFirst[_state + 1] && cMatches < cMaxMatches; i++)
+	{
+		const Rule& rule = _rules[_out[i]];
+		ULONGLONG first = _time[(_cPressed - rule.cSymbols) & (MAX_PATTERN_LEN - 1)];
+		if (rule.window && er.timestamp - first > rule.window) continue;
+
+		pMatches[cMatches].rule = _out[i];
+		pMatches[cMatches].sequence = er.sequence;
+		pMatches[cMatches].timestamp = er.timestamp;
+		cMatches++;
+	}
+	return cMatches;
+}
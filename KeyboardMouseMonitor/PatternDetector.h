@@ -0,0 +1,77 @@
+#pragma once
+#include "framework.h"
+#include "EventRecord.h"
+
+#include <vector>
+
+#define MAX_PATTERN_LEN 16              // Power of two, keys per rule
+#define MAX_RULE_TEXT 100
+#define SCANCODE_BITS 9                 // Scan code with the 0xE0 prefix folded into bit 8
+#define KEYSYMBOL_COUNT (1 << (SCANCODE_BITS + 4))
+
+// A decoded key press: extended scan code plus the MOD_ALT/MOD_CONTROL/MOD_SHIFT/MOD_WIN held with it
+typedef WORD KeySymbol;
+#define MAKEKEYSYMBOL(scanCode, modifiers) \
+	((KeySymbol)((((scanCode) & 0xFF) | (((scanCode) & 0xE000) ? 0x100 : 0)) | ((modifiers) << SCANCODE_BITS)))
+
+struct PatternMatch
+{
+	UINT      rule;         // Index of the rule, see RuleText()
+	UINT      sequence;     // Sequence number of the key press that completed the pattern
+	ULONGLONG timestamp;
+};
+
+// Detects key press patterns as they are recorded.
+//
+// The rules are compiled into one Aho-Corasick automaton with a complete transition
+// table over the key symbols that the rules use, so each key press costs one table
+// lookup no matter how many rules there are. A rule may require its keys to be typed
+// within a time limit; the timestamps of the last MAX_PATTERN_LEN key presses are kept
+// in a ring so the check is O(1) per match. The state is that of one keyboard, so feed it
+// the messages of one capture source.
+//
+// Rule text, one per line in a rules file:  [Ctrl+][Shift+][Alt+][Win+]<key> ... [<n>ms]
+// where <key> is a scan code such as 0x1E or 0xE04B.
+class PatternDetector
+{
+private:
+	struct Rule
+	{
+		KeySymbol symbol[MAX_PATTERN_LEN];
+		UINT      cSymbols;
+		ULONGLONG window;               // Microseconds, 0 for no limit
+		TCHAR     szText[MAX_RULE_TEXT];
+	};
+	std::vector<Rule> _rules;
+
+	// Compiled automaton
+	std::vector<UINT> _classOf;         // Key symbol to column, column 0 for symbols no rule uses
+	UINT              _cClasses;
+	std::vector<UINT> _next;            // Transition table, state * _cClasses + column
+	std::vector<UINT> _outFirst;        // Matched rules of each state: _out[_outFirst[s] .. _outFirst[s + 1])
+	std::vector<UINT> _out;
+	BOOL              _isCompiled;
+
+	// Streaming state
+	UINT      _state;
+	UINT      _modifiers;
+	UINT      _cPressed;
+	ULONGLONG _time[MAX_PATTERN_LEN];
+
+public:
+	PatternDetector();
+	BOOL AddRule(const KeySymbol* pSymbols, UINT cSymbols, UINT windowMs, const TCHAR* pszText);
+	BOOL AddRule(const TCHAR* pszRule);
+	UINT LoadRules(const TCHAR* pszPath);
+	void Compile();
+	void Reset();
+	void Resume(const KeySymbol* pSymbols, const ULONGLONG* pTimes, UINT cSymbols, UINT modifiers);
+
+	UINT OnEvent(const EventRecord& er, PatternMatch* pMatches, UINT cMaxMatches);
+
+	UINT Rules() const { return (UINT)_rules.size(); }
+	UINT States() const { return _cClasses ? (UINT)(_next.size() / _cClasses) : 0; }
+	const TCHAR* RuleText(UINT rule) const { return _rules[rule].szText; }
+
+	static UINT ModifierOf(WPARAM vk);
+};
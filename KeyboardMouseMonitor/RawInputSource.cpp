@@ -0,0 +1,337 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// RawInputSource.cpp : Provides a capture thread that records the input of every
+//                      keyboard and mouse through the Raw Input API.
+//
+//                      The thread owns a message-only window registered as an input
+//                      sink, so devices are captured even when the main window does
+//                      not have the focus. Each device feeds its own EventQueue.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "RawInputSource.h"
+
+#define RAW_INPUT_SINK_CLASS _T("KeyboardMouseMonitorRawInputSink")
+#define IDT_HEARTBEAT 1
+#define HEARTBEAT_INTERVAL 5    // Milliseconds between frontier updates of idle devices
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+RawInputSource::RawInputSource()
+{
+	_pMerger = NULL;
+	_hThread = NULL;
+	_hReady = NULL;
+	_hWndSink = NULL;
+	_isRunning = false;
+	_cDevices = 0;
+	ZeroMemory(_device, sizeof(_device));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Destructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+RawInputSource::~RawInputSource()
+{
+	Stop();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Start the capture thread and wait until its sink window is registered for raw input
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL RawInputSource::Start(EventMerger* pMerger)
+{
+	if (_isRunning) return true;
+	_pMerger = pMerger;
+
+	_hReady = CreateEvent(NULL, true, false, NULL);
+	if (_hReady == NULL) return false;
+	_hThread = CreateThread(NULL, 0, ThreadProc, this, 0, NULL);
+	if (_hThread == NULL)
+	{
+		CloseHandle(_hReady);
+		_hReady = NULL;
+		return false;
+	}
+	WaitForSingleObject(_hReady, INFINITE);
+	CloseHandle(_hReady);
+	_hReady = NULL;
+
+	// The thread leaves _hWndSink at NULL if registration failed
+	if (_hWndSink == NULL)
+	{
+		WaitForSingleObject(_hThread, INFINITE);
+		CloseHandle(_hThread);
+		_hThread = NULL;
+		return false;
+	}
+	_isRunning = true;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Stop the capture thread and close the device queues so they no longer hold back the merge
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void RawInputSource::Stop()
+{
+	if (!_isRunning) return;
+
+	PostMessage(_hWndSink, WM_CLOSE, 0, 0);
+	WaitForSingleObject(_hThread, INFINITE);
+	CloseHandle(_hThread);
+	_hThread = NULL;
+	_hWndSink = NULL;
+
+	for (UINT i = 0; i < _cDevices; i++) _device[i].pQueue->Close();
+	_isRunning = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Capture thread - Creates the sink window and runs its message loop
+///////////////////////////////////////////////////////////////////////////////////////////////////
+DWORD WINAPI RawInputSource::ThreadProc(LPVOID lpParameter)
+{
+	RawInputSource* pThis = (RawInputSource*)lpParameter;
+	HINSTANCE hInstance = GetModuleHandle(NULL);
+
+	WNDCLASSEX wcex;
+	ZeroMemory(&wcex, sizeof(wcex));
+	wcex.cbSize = sizeof(wcex);
+	wcex.lpfnWndProc = SinkProc;
+	wcex.hInstance = hInstance;
+	wcex.lpszClassName = RAW_INPUT_SINK_CLASS;
+	RegisterClassEx(&wcex); // Fails harmlessly if already registered by an earlier start
+
+	HWND hWnd = CreateWindowEx(0, RAW_INPUT_SINK_CLASS, NULL, 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, hInstance, NULL);
+	if (hWnd)
+	{
+		SetWindowLongPtr(hWnd, GWLP_USERDATA, (LONG_PTR)pThis);
+
+		RAWINPUTDEVICE rid[2];
+		rid[0].usUsagePage = 0x01; // Generic desktop controls
+		rid[0].usUsage = 0x06;     // Keyboard
+		rid[0].dwFlags = RIDEV_INPUTSINK;
+		rid[0].hwndTarget = hWnd;
+		rid[1].usUsagePage = 0x01; // Generic desktop controls
+		rid[1].usUsage = 0x02;     // Mouse
+		rid[1].dwFlags = RIDEV_INPUTSINK;
+		rid[1].hwndTarget = hWnd;
+		if (!RegisterRawInputDevices(rid, 2, sizeof(RAWINPUTDEVICE)))
+		{
+			DestroyWindow(hWnd);
+			hWnd = NULL;
+		}
+	}
+
+	// Reopen the queues of devices seen during an earlier start
+	for (UINT i = 0; i < pThis->_cDevices; i++) pThis->_device[i].pQueue->Open(EventTimestamp());
+
+	pThis->_hWndSink = hWnd;
+	SetEvent(pThis->_hReady);
+	if (hWnd == NULL) return 1;
+
+	SetTimer(hWnd, IDT_HEARTBEAT, HEARTBEAT_INTERVAL, NULL);
+
+	MSG msg;
+	while (GetMessage(&msg, NULL, 0, 0))
+	{
+		DispatchMessage(&msg);
+	}
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Sink window procedure - Runs on the capture thread
+///////////////////////////////////////////////////////////////////////////////////////////////////
+LRESULT CALLBACK RawInputSource::SinkProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
+{
+	RawInputSource* pThis = (RawInputSource*)GetWindowLongPtr(hWnd, GWLP_USERDATA);
+
+	switch (message)
+	{
+	case WM_INPUT:
+		if (pThis) pThis->OnInput((HRAWINPUT)lParam);
+		return DefWindowProc(hWnd, message, wParam, lParam);
+
+	case WM_TIMER:
+		if (pThis) pThis->Heartbeat();
+		break;
+
+	case WM_CLOSE:
+	{
+		// Unregister before the window goes away
+		RAWINPUTDEVICE rid[2];
+		rid[0].usUsagePage = 0x01;
+		rid[0].usUsage = 0x06;
+		rid[0].dwFlags = RIDEV_REMOVE;
+		rid[0].hwndTarget = NULL;
+		rid[1].usUsagePage = 0x01;
+		rid[1].usUsage = 0x02;
+		rid[1].dwFlags = RIDEV_REMOVE;
+		rid[1].hwndTarget = NULL;
+		RegisterRawInputDevices(rid, 2, sizeof(RAWINPUTDEVICE));
+		KillTimer(hWnd, IDT_HEARTBEAT);
+		DestroyWindow(hWnd);
+	}
+	break;
+
+	case WM_DESTROY:
+		PostQuitMessage(0);
+		break;
+
+	default:
+		return DefWindowProc(hWnd, message, wParam, lParam);
+	}
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Find the capture source of a device, adding one the first time the device is seen
+// Returns NULL when the merger has no free source slots
+///////////////////////////////////////////////////////////////////////////////////////////////////
+RawInputSource::Device* RawInputSource::FindDevice(HANDLE hDevice)
+{
+	for (UINT i = 0; i < _cDevices; i++)
+	{
+		if (_device[i].hDevice == hDevice) return &_device[i];
+	}
+	if (_cDevices == MAX_SOURCES) return NULL;
+
+	UINT source;
+	EventQueue* pQueue = _pMerger->AddSource(RAW_INPUT_QUEUE_CAPACITY, &source);
+	if (pQueue == NULL) return NULL;
+
+	Device* pDevice = &_device[_cDevices++];
+	ZeroMemory(pDevice, sizeof(Device));
+	pDevice->hDevice = hDevice;
+	pDevice->pQueue = pQueue;
+	pDevice->source = source;
+	return pDevice;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Decode one raw input report
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void RawInputSource::OnInput(HRAWINPUT hRawInput)
+{
+	ULONGLONG timestamp = EventTimestamp();
+
+	RAWINPUT ri;
+	UINT cbri = sizeof(ri);
+	if (GetRawInputData(hRawInput, RID_INPUT, &ri, &cbri, sizeof(RAWINPUTHEADER)) == (UINT)-1) return;
+
+	// Injected input (SendInput) has no device handle, and is kept as a device of its own
+	Device* pDevice = FindDevice(ri.header.hDevice);
+	if (pDevice == NULL) return;
+
+	if (ri.header.dwType == RIM_TYPEKEYBOARD) OnKeyboard(pDevice, ri.data.keyboard, timestamp);
+	if (ri.header.dwType == RIM_TYPEMOUSE)    OnMouse(pDevice, ri.data.mouse, timestamp);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Translate a keyboard report to WM_KEYDOWN/WM_KEYUP with the same lParam layout
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void RawInputSource::OnKeyboard(Device* pDevice, const RAWKEYBOARD& kb, ULONGLONG timestamp)
+{
+	if (kb.VKey >= 256) return; // Overrun or fake key (0xFF is used for E1 prefixes)
+
+	BYTE bit = (BYTE)(1 << (kb.VKey & 7));
+	BOOL wasDown = (pDevice->keyDown[kb.VKey >> 3] & bit) != 0;
+	BOOL isUp = (kb.Flags & RI_KEY_BREAK) != 0;
+	if (isUp) pDevice->keyDown[kb.VKey >> 3] &= ~bit;
+	else      pDevice->keyDown[kb.VKey >> 3] |= bit;
+
+	WORD flags = (WORD)LOBYTE(kb.MakeCode);
+	if (kb.Flags & RI_KEY_E0) flags |= KF_EXTENDED;
+	if (kb.Message == WM_SYSKEYDOWN || kb.Message == WM_SYSKEYUP)
+	{
+		if (pDevice->keyDown[VK_MENU >> 3] & (1 << (VK_MENU & 7))) flags |= KF_ALTDOWN;
+	}
+	if (wasDown) flags |= KF_REPEAT;
+	if (isUp) flags |= KF_UP;
+
+	EventRecord er;
+	er.sequence = 0;
+	er.message = kb.Message;
+	er.wParam = kb.VKey;
+	er.lParam = (LPARAM)(DWORD)MAKELONG(1, flags);
+	er.timestamp = timestamp;
+	er.source = pDevice->source;
+	pDevice->pQueue->Push(er);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Translate a mouse report to the button, wheel and move messages it represents
+// As in the main window, moves are only recorded while at least one button is down.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void RawInputSource::OnMouse(Device* pDevice, const RAWMOUSE& m, ULONGLONG timestamp)
+{
+	static const struct
+	{
+		USHORT flag;
+		UINT   message;
+		WPARAM button;      // MK_xBUTTON bit that changes
+		WORD   xbutton;     // XBUTTON1/XBUTTON2 for the X buttons
+	} map[] =
+	{
+		{ RI_MOUSE_LEFT_BUTTON_DOWN,   WM_LBUTTONDOWN, MK_LBUTTON,  0        },
+		{ RI_MOUSE_LEFT_BUTTON_UP,     WM_LBUTTONUP,   MK_LBUTTON,  0        },
+		{ RI_MOUSE_RIGHT_BUTTON_DOWN,  WM_RBUTTONDOWN, MK_RBUTTON,  0        },
+		{ RI_MOUSE_RIGHT_BUTTON_UP,    WM_RBUTTONUP,   MK_RBUTTON,  0        },
+		{ RI_MOUSE_MIDDLE_BUTTON_DOWN, WM_MBUTTONDOWN, MK_MBUTTON,  0        },
+		{ RI_MOUSE_MIDDLE_BUTTON_UP,   WM_MBUTTONUP,   MK_MBUTTON,  0        },
+		{ RI_MOUSE_BUTTON_4_DOWN,      WM_XBUTTONDOWN, MK_XBUTTON1, XBUTTON1 },
+		{ RI_MOUSE_BUTTON_4_UP,        WM_XBUTTONUP,   MK_XBUTTON1, XBUTTON1 },
+		{ RI_MOUSE_BUTTON_5_DOWN,      WM_XBUTTONDOWN, MK_XBUTTON2, XBUTTON2 },
+		{ RI_MOUSE_BUTTON_5_UP,        WM_XBUTTONUP,   MK_XBUTTON2, XBUTTON2 },
+	};
+
+	// Raw input carries no position, so use the cursor position in screen coordinates
+	POINT pt;
+	GetCursorPos(&pt);
+
+	WPARAM modifiers = 0;
+	if (GetAsyncKeyState(VK_SHIFT) & 0x8000)   modifiers |= MK_SHIFT;
+	if (GetAsyncKeyState(VK_CONTROL) & 0x8000) modifiers |= MK_CONTROL;
+
+	EventRecord er;
+	er.sequence = 0;
+	er.lParam = MAKELPARAM(pt.x, pt.y);
+	er.timestamp = timestamp;
+	er.source = pDevice->source;
+
+	if ((m.lLastX || m.lLastY) && pDevice->buttons)
+	{
+		er.message = WM_MOUSEMOVE;
+		er.wParam = pDevice->buttons | modifiers;
+		pDevice->pQueue->Push(er);
+	}
+
+	for (UINT i = 0; i < ARRAYSIZE(map); i++)
+	{
+		if (!(m.usButtonFlags & map[i].flag)) continue;
+		if (map[i].message == WM_LBUTTONDOWN || map[i].message == WM_RBUTTONDOWN ||
+			map[i].message == WM_MBUTTONDOWN || map[i].message == WM_XBUTTONDOWN) pDevice->buttons |= map[i].button;
+		else pDevice->buttons &= ~map[i].button;
+
+		er.message = map[i].message;
+		er.wParam = MAKEWPARAM(pDevice->buttons | modifiers, map[i].xbutton);
+		pDevice->pQueue->Push(er);
+	}
+
+	if (m.usButtonFlags & RI_MOUSE_WHEEL)
+	{
+		er.message = WM_MOUSEWHEEL;
+		er.wParam = MAKEWPARAM(pDevice->buttons | modifiers, (SHORT)m.usButtonData);
+		pDevice->pQueue->Push(er);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Tell the merger that idle devices have nothing older than now
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void RawInputSource::Heartbeat()
+{
+	ULONGLONG now = EventTimestamp();
+	for (UINT i = 0; i < _cDevices; i++) _device[i].pQueue->Heartbeat(now);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "framework.h"
+#include "EventMerger.h"
+
+#define RAW_INPUT_QUEUE_CAPACITY 8192
+
+// Captures every keyboard and mouse on its own thread through the Raw Input API.
+// Each physical device gets its own capture source in the EventMerger, and the raw
+// reports are translated to the equivalent window messages so that they decode and
+// display exactly like the messages sent to the main window.
+class RawInputSource
+{
+private:
+	struct Device
+	{
+		HANDLE      hDevice;
+		EventQueue* pQueue;
+		UINT        source;
+		WPARAM      buttons;        // MK_xBUTTON state of a mouse
+		BYTE        keyDown[32];    // One bit per virtual key of a keyboard
+	};
+
+	EventMerger* _pMerger;
+	HANDLE       _hThread;
+	HANDLE       _hReady;
+	HWND         _hWndSink;
+	BOOL         _isRunning;
+	Device       _device[MAX_SOURCES];
+	UINT         _cDevices;
+
+	static DWORD WINAPI ThreadProc(LPVOID lpParameter);
+	static LRESULT CALLBACK SinkProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
+	Device* FindDevice(HANDLE hDevice);
+	void OnInput(HRAWINPUT hRawInput);
+	void OnKeyboard(Device* pDevice, const RAWKEYBOARD& kb, ULONGLONG timestamp);
+	void OnMouse(Device* pDevice, const RAWMOUSE& m, ULONGLONG timestamp);
+	void Heartbeat();
+public:
+	RawInputSource();
+	~RawInputSource();
+	BOOL Start(EventMerger* pMerger);
+	void Stop();
+	BOOL isRunning() { return _isRunning; }
+};
@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Trajectory.cpp : Provides mouse trajectory analytics - speed, acceleration, jitter and the
+//                  effective polling rate of the device - over sliding windows of recorded moves,
+//                  live or as a batch pass over captured logs.
+//
+//                  The kernels run over structure-of-arrays buffers. Every loop is branch free,
+//                  with the movement gaps applied as 0/1 masks, and the interval variance is
+//                  taken about the mean of the first pass, as the sums of squares would cancel.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "Trajectory.h"
+
+#include <math.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Batch kernel
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void AnalyzeTrajectory(const float* pX, const float* pY, const ULONGLONG* pT, UINT n, float* pScratch, TrajectoryStats* pStats)
+{
+	ZeroMemory(pStats, sizeof(TrajectoryStats));
+	pStats->cSamples = n;
+	if (n < 2) return;
+
+	// Pass 1: speed of every interval into the scratch buffer, the mean interval
+	ULONGLONG sumDt = 0;
+	UINT cValid = 0;
+	double sumSpeed = 0.0;
+	float peakSpeed = 0.0f;
+	pScratch[0] = 0.0f;
+	for (UINT i = 1; i < n; i++)
+	{
+		LONGLONG dt = (LONGLONG)(pT[i] - pT[i - 1]);
+		float dx = pX[i] - pX[i - 1];
+		float dy = pY[i] - pY[i - 1];
+		UINT valid = dt > 0 && dt < TRAJECTORY_GAP ? 1 : 0;
+		float speed = valid * sqrtf(dx * dx + dy * dy) * 1e6f / (float)(dt > 0 ? dt : 1);
+		pScratch[i] = speed;
+		sumDt += valid * dt;
+		cValid += valid;
+		sumSpeed += speed;
+		peakSpeed = speed > peakSpeed ? speed : peakSpeed;
+	}
+	pStats->cIntervals = cValid;
+	if (cValid == 0) return;
+	double meanDt = (double)sumDt / cValid;
+
+	// Pass 2: deviation of the intervals from the mean, acceleration between consecutive
+	// valid intervals, and path jitter
+	LONGLONG dt0 = (LONGLONG)(pT[1] - pT[0]);
+	double dev0 = dt0 > 0 && dt0 < TRAJECTORY_GAP ? dt0 - meanDt : 0.0;
+	double sumDev2 = dev0 * dev0;
+	double sumAccel = 0.0, sumJitter = 0.0;
+	float peakAccel = 0.0f;
+	UINT cPairs = 0;
+	for (UINT i = 2; i < n; i++)
+	{
+		dt0 = (LONGLONG)(pT[i - 1] - pT[i - 2]);
+		LONGLONG dt1 = (LONGLONG)(pT[i] - pT[i - 1]);
+		UINT valid0 = dt0 > 0 && dt0 < TRAJECTORY_GAP ? 1 : 0;
+		UINT valid1 = dt1 > 0 && dt1 < TRAJECTORY_GAP ? 1 : 0;
+		double dev = valid1 * (dt1 - meanDt);
+		UINT valid = valid0 & valid1;
+		float accel = valid * fabsf(pScratch[i] - pScratch[i - 1]) * 1e6f / (float)(dt1 > 0 ? dt1 : 1);
+		float ddx = pX[i] - 2.0f * pX[i - 1] + pX[i - 2];
+		float ddy = pY[i] - 2.0f * pY[i - 1] + pY[i - 2];
+		sumDev2 += dev * dev;
+		sumAccel += accel;
+		peakAccel = accel > peakAccel ? accel : peakAccel;
+		sumJitter += valid * sqrtf(ddx * ddx + ddy * ddy);
+		cPairs += valid;
+	}
+
+	pStats->pollingRate = meanDt > 0.0 ? (float)(1e6 / meanDt) : 0.0f;
+	pStats->intervalJitter = (float)(sqrt(sumDev2 / cValid) * 1e-6);
+	pStats->meanSpeed = (float)(sumSpeed / cValid);
+	pStats->peakSpeed = peakSpeed;
+	if (cPairs)
+	{
+		pStats->meanAcceleration = (float)(sumAccel / cPairs);
+		pStats->peakAcceleration = peakAccel;
+		pStats->pathJitter = (float)(sumJitter / cPairs);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+TrajectoryAnalyzer::TrajectoryAnalyzer()
+{
+	Reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Forget all samples
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void TrajectoryAnalyzer::Reset()
+{
+	_next = 0;
+	_count = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Add a position - Timestamps are in microseconds, see EventTimestamp()
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void TrajectoryAnalyzer::Add(int x, int y, ULONGLONG timestamp)
+{
+	// Out of order, keep the window in time order
+	if (_count && timestamp < _t[(_next - 1) & (TRAJECTORY_WINDOW - 1)]) return;
+
+	_x[_next] = _x[_next + TRAJECTORY_WINDOW] = (float)x;
+	_y[_next] = _y[_next + TRAJECTORY_WINDOW] = (float)y;
+	_t[_next] = _t[_next + TRAJECTORY_WINDOW] = timestamp;
+	_next = (_next + 1) & (TRAJECTORY_WINDOW - 1);
+	if (_count < TRAJECTORY_WINDOW) _count++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Analyze the current window - Returns false until there are at least two samples
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL TrajectoryAnalyzer::Analyze(TrajectoryStats* pStats)
+{
+	// The oldest sample is at _next when the window is full, at 0 before that
+	UINT first = _count == TRAJECTORY_WINDOW ? _next : 0;
+	AnalyzeTrajectory(&_x[first], &_y[first], &_t[first], _count, _scratch, pStats);
+	return _count >= 2;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "framework.h"
+
+#define TRAJECTORY_WINDOW 1024          // Samples in the live sliding window, power of two
+#define TRAJECTORY_GAP 50000            // Microseconds between samples that end a movement
+
+// Statistics of a window of mouse positions
+struct TrajectoryStats
+{
+	UINT  cSamples;
+	UINT  cIntervals;       // Intervals within a movement, shorter than TRAJECTORY_GAP
+	float pollingRate;      // Reports per second
+	float intervalJitter;   // Standard deviation of the interval, seconds
+	float meanSpeed;        // Pixels per second
+	float peakSpeed;
+	float meanAcceleration; // Pixels per second squared, magnitude of the change in speed
+	float peakAcceleration;
+	float pathJitter;       // Mean magnitude of the second difference of position, pixels
+};
+
+// Batch kernel over structure-of-arrays buffers: x, y in pixels and t in microseconds, see
+// EventTimestamp(), in time order. 64 bit integer times keep the intervals exact however long
+// the log, and the sums are kept in integers and doubles so they stay accurate over millions
+// of samples.
+// Intervals of TRAJECTORY_GAP or more, or that run backwards as between two capture files,
+// separate movements and are left out of every statistic. pScratch must hold n floats.
+void AnalyzeTrajectory(const float* pX, const float* pY, const ULONGLONG* pT, UINT n, float* pScratch, TrajectoryStats* pStats);
+
+// Sliding window of the most recent positions of one device, for live analysis.
+// Each sample is stored twice, at i and i + TRAJECTORY_WINDOW, so that the window is always
+// one contiguous run the batch kernel can read.
+class TrajectoryAnalyzer
+{
+private:
+	alignas(16) float     _x[2 * TRAJECTORY_WINDOW];
+	alignas(16) float     _y[2 * TRAJECTORY_WINDOW];
+	alignas(16) ULONGLONG _t[2 * TRAJECTORY_WINDOW];
+	alignas(16) float     _scratch[TRAJECTORY_WINDOW];
+	UINT      _next;        // Slot of the next sample
+	UINT      _count;
+public:
+	TrajectoryAnalyzer();
+	void Reset();
+	void Add(int x, int y, ULONGLONG timestamp);
+	BOOL Analyze(TrajectoryStats* pStats);
+	UINT Count() const { return _count; }
+};
@@ -0,0 +1,430 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// TypedText.cpp : Provides the text reconstructed from the typed characters, with a search index.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "framework.h"
+#include "TypedText.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Constructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+TypedText::TypedText()
+{
+	_block = 0;
+	_offset = 0;
+	_cursor = 0;
+	_cChars = 0;
+	Clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Destructor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+TypedText::~TypedText()
+{
+	for (Block* pBlock : _blocks) delete pBlock;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Remove all the text, leaving one empty block
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void TypedText::Clear()
+{
+	for (Block* pBlock : _blocks) delete pBlock;
+	_blocks.clear();
+
+	Block* pBlock = new Block;
+	ZeroMemory(pBlock, sizeof(Block));
+	_blocks.push_back(pBlock);
+	_block = 0;
+	_offset = 0;
+	_cursor = 0;
+	_cChars = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Apply a recorded message to the text
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void TypedText::OnEvent(const EventRecord& er)
+{
+	if (er.message == WM_CHAR || er.message == WM_SYSCHAR)
+	{
+		TCHAR ch = (TCHAR)er.wParam;
+		if (ch == VK_BACK) Backspace();
+		else if (ch == VK_RETURN) Insert(_T('\n'), er.sequence);
+		else if (ch == _T('\t') || ch >= _T(' ')) Insert(ch, er.sequence);
+	}
+	else if (er.message == WM_KEYDOWN)
+	{
+		switch (er.wParam)
+		{
+		case VK_LEFT:   Left(); break;
+		case VK_RIGHT:  Right(); break;
+		case VK_HOME:   Home(); break;
+		case VK_END:    End(); break;
+		case VK_DELETE: Delete(); break;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The filter bit of a trigram
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT TypedText::TrigramBit(TCHAR a, TCHAR b, TCHAR c)
+{
+	UINT h = ((UINT)(WORD)a * 0x9E3779B1u) ^ ((UINT)(WORD)b * 0x85EBCA77u) ^ ((UINT)(WORD)c * 0xC2B2AE3Du);
+	return (h ^ (h >> 15)) & (TEXT_FILTER_BITS - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The character at an offset from the start of a block, which may be in a following block
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL TypedText::At(UINT block, UINT offset, TCHAR* pch) const
+{
+	while (block < _blocks.size() && offset >= _blocks[block]->cChars)
+	{
+		offset -= _blocks[block]->cChars;
+		block++;
+	}
+	if (block >= _blocks.size()) return false;
+
+	*pch = _blocks[block]->ch[offset];
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Mark the filters that an edit at a block offset may have made miss trigrams
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void TypedText::MarkStale(UINT block, UINT offset)
+{
+	_blocks[block]->bStale = true;
+
+	// Trigrams starting in the last two characters of the blocks before use this block's first two
+	for (UINT b = block, reach = offset; b > 0 && reach < 2; )
+	{
+		b--;
+		_blocks[b]->bStale = true;
+		reach += _blocks[b]->cChars;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Rebuild the filter of a block from its trigrams
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void TypedText::Rebuild(UINT block)
+{
+	Block* pBlock = _blocks[block];
+	ZeroMemory(pBlock->filter, sizeof(pBlock->filter));
+	for (UINT i = 0; i < pBlock->cChars; i++)
+	{
+		TCHAR b, c;
+		if (!At(block, i + 1, &b) || !At(block, i + 2, &c)) break;
+		UINT bit = TrigramBit(pBlock->ch[i], b, c);
+		pBlock->filter[bit >> 5] |= 1u << (bit & 31);
+	}
+	pBlock->bStale = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Insert a character at the cursor
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void TypedText::Insert(TCHAR ch, UINT sequence)
+{
+	Block* pBlock = _blocks[_block];
+	if (pBlock->cChars == TEXT_BLOCK)
+	{
+		// Split the full block; appending at the end of the text starts an empty one instead
+		Block* pNew = new Block;
+		ZeroMemory(pNew, sizeof(Block));
+		UINT keep = _offset == TEXT_BLOCK && _block + 1 == _blocks.size() ? TEXT_BLOCK : TEXT_BLOCK / 2;
+		pNew->cChars = TEXT_BLOCK - keep;
+		memcpy(pNew->ch, pBlock->ch + keep, pNew->cChars * sizeof(TCHAR));
+		memcpy(pNew->sequence, pBlock->sequence + keep, pNew->cChars * sizeof(UINT));
+		pBlock->cChars = keep;
+		_blocks.insert(_blocks.begin() + _block + 1, pNew);
+		if (keep < TEXT_BLOCK)
+		{
+			pBlock->bStale = true;
+			pNew->bStale = true;
+		}
+		if (_offset >= keep)
+		{
+			_block++;
+			_offset -= keep;
+			pBlock = pNew;
+		}
+	}
+
+	BOOL bAppend = _cursor == _cChars;
+	memmove(pBlock->ch + _offset + 1, pBlock->ch + _offset, (pBlock->cChars - _offset) * sizeof(TCHAR));
+	memmove(pBlock->sequence + _offset + 1, pBlock->sequence + _offset, (pBlock->cChars - _offset) * sizeof(UINT));
+	pBlock->ch[_offset] = ch;
+	pBlock->sequence[_offset] = sequence;
+	pBlock->cChars++;
+	_offset++;
+	_cursor++;
+	_cChars++;
+
+	if (!bAppend)
+	{
+		MarkStale(_block, _offset - 1);
+		return;
+	}
+
+	// Appending completes just the trigram that starts two characters back
+	if (_cursor >= 3)
+	{
+		UINT block = _block, offset = _offset - 1;
+		for (UINT back = 2; back; back--)
+		{
+			while (offset == 0) offset = _blocks[--block]->cChars;
+			offset--;
+		}
+		TCHAR b, c;
+		if (At(block, offset + 1, &b) && At(block, offset + 2, &c))
+		{
+			UINT bit = TrigramBit(_blocks[block]->ch[offset], b, c);
+			_blocks[block]->filter[bit >> 5] |= 1u << (bit & 31);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Delete the character before the cursor - Returns false at the start of the text
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL TypedText::Backspace()
+{
+	if (!Left()) return false;
+	return Delete();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Delete the character after the cursor - Returns false at the end of the text
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL TypedText::Delete()
+{
+	if (_cursor == _cChars) return false;
+
+	// The cursor may be at the end of a block, the character is then at the start of the next
+	while (_offset == _blocks[_block]->cChars)
+	{
+		_block++;
+		_offset = 0;
+	}
+
+	Block* pBlock = _blocks[_block];
+	pBlock->cChars--;
+	memmove(pBlock->ch + _offset, pBlock->ch + _offset + 1, (pBlock->cChars - _offset) * sizeof(TCHAR));
+	memmove(pBlock->sequence + _offset, pBlock->sequence + _offset + 1, (pBlock->cChars - _offset) * sizeof(UINT));
+	_cChars--;
+
+	// Deleting at the end of the text leaves no new trigram; the filter only holds one too many
+	if (_cursor != _cChars) MarkStale(_block, _offset);
+
+	// Drop the block once it is empty, unless it is the only one
+	if (pBlock->cChars == 0 && _blocks.size() > 1)
+	{
+		delete pBlock;
+		_blocks.erase(_blocks.begin() + _block);
+		if (_block > 0)
+		{
+			_block--;
+			_offset = _blocks[_block]->cChars;
+		}
+		else
+		{
+			_offset = 0;
+		}
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Move the cursor one character back - Returns false at the start of the text
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL TypedText::Left()
+{
+	if (_cursor == 0) return false;
+
+	while (_offset == 0)
+	{
+		_block--;
+		_offset = _blocks[_block]->cChars;
+	}
+	_offset--;
+	_cursor--;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Move the cursor one character on - Returns false at the end of the text
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL TypedText::Right()
+{
+	if (_cursor == _cChars) return false;
+
+	while (_offset == _blocks[_block]->cChars)
+	{
+		_block++;
+		_offset = 0;
+	}
+	_offset++;
+	_cursor++;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Move the cursor to the start of its line
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void TypedText::Home()
+{
+	TCHAR ch;
+	while (_cursor > 0)
+	{
+		Left();
+		CharAt(_cursor, &ch, NULL);
+		if (ch == _T('\n'))
+		{
+			Right();
+			break;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Move the cursor to the end of its line
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void TypedText::End()
+{
+	TCHAR ch;
+	while (CharAt(_cursor, &ch, NULL) && ch != _T('\n')) Right();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Find the block and offset of a position, the cursor's block when it is the cursor position
+///////////////////////////////////////////////////////////////////////////////////////////////////
+void TypedText::Locate(UINT position, UINT* pBlock, UINT* pOffset) const
+{
+	if (position == _cursor)
+	{
+		*pBlock = _block;
+		*pOffset = _offset;
+		return;
+	}
+
+	UINT block = 0;
+	while (block + 1 < _blocks.size() && position >= _blocks[block]->cChars)
+	{
+		position -= _blocks[block]->cChars;
+		block++;
+	}
+	*pBlock = block;
+	*pOffset = position;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The character at a position and the sequence number of the message that typed it
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL TypedText::CharAt(UINT position, TCHAR* pch, UINT* pSequence) const
+{
+	if (position >= _cChars) return false;
+
+	UINT block, offset;
+	Locate(position, &block, &offset);
+	while (offset == _blocks[block]->cChars)
+	{
+		block++;
+		offset = 0;
+	}
+	*pch = _blocks[block]->ch[offset];
+	if (pSequence) *pSequence = _blocks[block]->sequence[offset];
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Copy the text from a position into a buffer - Returns the characters copied
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT TypedText::GetText(UINT position, TCHAR* psz, UINT cch) const
+{
+	if (cch == 0) return 0;
+
+	UINT block, offset, cCopied = 0;
+	Locate(position < _cChars ? position : _cChars, &block, &offset);
+	while (cCopied + 1 < cch && block < _blocks.size())
+	{
+		if (offset == _blocks[block]->cChars)
+		{
+			block++;
+			offset = 0;
+			continue;
+		}
+		psz[cCopied++] = _blocks[block]->ch[offset++];
+	}
+	psz[cCopied] = 0;
+	return cCopied;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Whether the query starts at an offset of a block
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL TypedText::MatchAt(UINT block, UINT offset, const TCHAR* pszQuery, UINT cchQuery) const
+{
+	for (UINT i = 0; i < cchQuery; i++)
+	{
+		while (offset == _blocks[block]->cChars)
+		{
+			if (++block == _blocks.size()) return false;
+			offset = 0;
+		}
+		if (_blocks[block]->ch[offset++] != pszQuery[i]) return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Find the first occurrence of the query at or after a position - Returns TEXT_NOT_FOUND if none
+///////////////////////////////////////////////////////////////////////////////////////////////////
+UINT TypedText::Find(const TCHAR* pszQuery, UINT from)
+{
+	UINT cchQuery = (UINT)_tcslen(pszQuery);
+	if (cchQuery == 0 || cchQuery > MAX_QUERY_LEN || cchQuery > _cChars) return TEXT_NOT_FOUND;
+
+	// The filter bits of the query trigrams
+	UINT bits[MAX_QUERY_LEN];
+	UINT cBits = cchQuery >= 3 ? cchQuery - 2 : 0;
+	for (UINT i = 0; i < cBits; i++) bits[i] = TrigramBit(pszQuery[i], pszQuery[i + 1], pszQuery[i + 2]);
+
+	UINT start = 0;                         // Position of the first character of the block
+	for (UINT block = 0; block < _blocks.size(); start += _blocks[block]->cChars, block++)
+	{
+		const Block* pBlock = _blocks[block];
+		if (start + pBlock->cChars <= from) continue;
+
+		// A match starting here has its trigrams in the filters of this block and those it reaches into
+		BOOL bCandidate = true;
+		for (UINT i = 0; i < cBits && bCandidate; i++)
+		{
+			bCandidate = false;
+			for (UINT b = block, reach = 0; b < _blocks.size() && reach < pBlock->cChars + cchQuery; b++)
+			{
+				if (_blocks[b]->bStale) Rebuild(b);
+				if (_blocks[b]->filter[bits[i] >> 5] & (1u << (bits[i] & 31)))
+				{
+					bCandidate = true;
+					break;
+				}
+				reach += _blocks[b]->cChars;
+			}
+		}
+		if (!bCandidate) continue;
+
+		for (UINT offset = from > start ? from - start : 0; offset < pBlock->cChars; offset++)
+		{
+			if (pBlock->ch[offset] == pszQuery[0] && MatchAt(block, offset, pszQuery, cchQuery))
+			{
+				return start + offset;
+			}
+		}
+	}
+	return TEXT_NOT_FOUND;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "framework.h"
+#include "EventRecord.h"
+
+#include <vector>
+
+#define TEXT_BLOCK 2048                     // Most characters per block
+#define TEXT_FILTER_BITS 8192               // Power of two, bits of the trigram filter of a block
+#define MAX_QUERY_LEN 256
+#define TEXT_NOT_FOUND ((UINT)-1)
+
+// The text reconstructed from the typed characters, as an edit box with the focus would have it.
+//
+// WM_CHAR and WM_SYSCHAR insert at the cursor, backspace deletes before it, and the arrow,
+// Home, End and Delete keys move the cursor and delete after it. Every character keeps the
+// sequence number of the message that typed it, so a search hit leads to the raw messages.
+// Feed it the messages of one capture source, or every key would move and delete twice.
+//
+// The text is a list of blocks of up to TEXT_BLOCK characters (a flat rope), so an edit
+// anywhere moves at most one block. Each block has a filter of the trigrams that start in
+// it. Typing at the end of the text adds to the filter as it goes; other edits mark the
+// filter stale and it is rebuilt at the next search. A search scans only the blocks whose
+// filters (with the next block's) hold every trigram of the query.
+class TypedText
+{
+private:
+	struct Block
+	{
+		UINT  cChars;
+		BOOL  bStale;                       // The filter misses trigrams, rebuild before searching
+		TCHAR ch[TEXT_BLOCK];
+		UINT  sequence[TEXT_BLOCK];
+		UINT  filter[TEXT_FILTER_BITS / 32];
+	};
+	std::vector<Block*> _blocks;
+	UINT _block;                            // Cursor block
+	UINT _offset;                           // Cursor offset in the block, 0 to cChars
+	UINT _cursor;                           // Cursor position in the text
+	UINT _cChars;
+
+	static UINT TrigramBit(TCHAR a, TCHAR b, TCHAR c);
+	BOOL At(UINT block, UINT offset, TCHAR* pch) const;
+	void MarkStale(UINT block, UINT offset);
+	void Rebuild(UINT block);
+	BOOL MatchAt(UINT block, UINT offset, const TCHAR* pszQuery, UINT cchQuery) const;
+	void Locate(UINT position, UINT* pBlock, UINT* pOffset) const;
+public:
+	TypedText();
+	~TypedText();
+	TypedText(const TypedText&) = delete;
+	TypedText& operator=(const TypedText&) = delete;
+
+	void Clear();
+	void OnEvent(const EventRecord& er);
+	void Insert(TCHAR ch, UINT sequence);
+	BOOL Backspace();
+	BOOL Delete();
+	BOOL Left();
+	BOOL Right();
+	void Home();
+	void End();
+
+	UINT Length() const { return _cChars; }
+	UINT Cursor() const { return _cursor; }
+	BOOL CharAt(UINT position, TCHAR* pch, UINT* pSequence) const;
+	UINT GetText(UINT position, TCHAR* psz, UINT cch) const;
+	UINT Find(const TCHAR* pszQuery, UINT from);
+};
@@ -12,7 +12,17 @@
 #define IDI_SMALL                       108
 #define IDC_KEYBOARDMOUSEMONITOR        109
 #define IDR_MAINFRAME                   128
+#define IDD_FINDTYPED                   129
+#define IDC_FINDTEXT                    1000
 #define ID_EDIT_FONT                    32774
+#define ID_EDIT_CAPTUREALLDEVICES       32775
+#define ID_EDIT_LOADTEST                32776
+#define ID_VIEW_HEATMAP                 32777
+#define ID_EDIT_FOLDREPEATS             32778
+#define ID_VIEW_FREEZE                  32779
+#define ID_EDIT_FINDTYPED               32780
+#define ID_FILE_SAVECAPTURE             32781
+#define ID_VIEW_KEYSTROKES              32782
 #define IDC_STATIC                      -1
 
 // Next default values for new objects
@@ -20,9 +30,9 @@
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NO_MFC                     1
-#define _APS_NEXT_RESOURCE_VALUE        129
-#define _APS_NEXT_COMMAND_VALUE         32775
-#define _APS_NEXT_CONTROL_VALUE         1000
+#define _APS_NEXT_RESOURCE_VALUE        130
+#define _APS_NEXT_COMMAND_VALUE         32783
+#define _APS_NEXT_CONTROL_VALUE         1001
 #define _APS_NEXT_SYMED_VALUE           110
 #endif
 #endif
@@ -0,0 +1,337 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Portable.cpp : Provides the Windows API functions that the portable pieces of KeyboardMouseMonitor
+//                use, for building them on other platforms.
+//
+//                The registry is kept in files - A key is a directory under $XDG_CONFIG_HOME
+//                (or ~/.config) and a value is a file in it. The version resource is built
+//                from the strings given to the build.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "windows.h"
+#include "strsafe.h"
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+
+#ifndef PORTABLE_COMPANY_NAME
+#define PORTABLE_COMPANY_NAME "Alex Sokolek"
+#endif
+#ifndef PORTABLE_PRODUCT_NAME
+#define PORTABLE_PRODUCT_NAME "Keyboard Mouse Monitor"
+#endif
+#ifndef PORTABLE_PRODUCT_VERSION
+#define PORTABLE_PRODUCT_VERSION "1.0.0.3"
+#endif
+
+#define VERSION_LANGUAGE 0x0409
+#define VERSION_CODEPAGE 1200
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Time
+///////////////////////////////////////////////////////////////////////////////////////////////////
+BOOL QueryPerformanceCounter(LARGE_INTEGER* pCounter)
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	pCounter->QuadPart = (LONGLONG)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* pFrequency)
+{
+	pFrequency->QuadPart = 1000000000LL;
+	return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Errors and messages
+///////////////////////////////////////////////////////////////////////////////////////////////////
+DWORD GetLastError()
+{
+	return (DWORD)errno;
+}
+
+int MessageBox(HWND hWnd, const TCHAR* pszText, const TCHAR* pszCaption, UINT type)
+{
+	UNREFERENCED_PARAMETER(hWnd);
+	UNREFERENCED_PARAMETER(type);
+	fprintf(stderr, "%s: %s\n", pszCaption ? pszCaption : "", pszText ? pszText : "");
+	return IDOK;
+}
+
+BOOL MessageBeep(UINT type)
+{
+	UNREFERENCED_PARAMETER(type);
+	return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Modules and their version resource
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct VersionInfo
+{
+	WORD  translation[2];
+	TCHAR szCompanyName[64];
+	TCHAR szProductName[64];
+	TCHAR szProductVersion[64];
+};
+
+DWORD GetModuleFileName(HANDLE hModule, TCHAR* pszFileName, DWORD cchFileName)
+{
+	if (hModule != NULL || cchFileName == 0)
+	{
+		errno = EINVAL;
+		return 0;
+	}
+	ssize_t cch = readlink("/proc/self/exe", pszFileName, cchFileName - 1);
+	if (cch < 0) return 0;
+	pszFileName[cch] = 0;
+	return (DWORD)cch;
+}
+
+DWORD GetFileVersionInfoSize(const TCHAR* pszFileName, DWORD* pHandle)
+{
+	UNREFERENCED_PARAMETER(pszFileName);
+	if (pHandle) *pHandle = 0;
+	return sizeof(VersionInfo);
+}
+
+BOOL GetFileVersionInfo(const TCHAR* pszFileName, DWORD handle, DWORD cbData, LPVOID pData)
+{
+	UNREFERENCED_PARAMETER(pszFileName);
+	UNREFERENCED_PARAMETER(handle);
+	if (cbData < sizeof(VersionInfo))
+	{
+		errno = ENOBUFS;
+		return false;
+	}
+	VersionInfo* pvi = (VersionInfo*)pData;
+	pvi->translation[0] = VERSION_LANGUAGE;
+	pvi->translation[1] = VERSION_CODEPAGE;
+	StringCchCopy(pvi->szCompanyName, ARRAYSIZE(pvi->szCompanyName), PORTABLE_COMPANY_NAME);
+	StringCchCopy(pvi->szProductName, ARRAYSIZE(pvi->szProductName), PORTABLE_PRODUCT_NAME);
+	StringCchCopy(pvi->szProductVersion, ARRAYSIZE(pvi->szProductVersion), PORTABLE_PRODUCT_VERSION);
+	return true;
+}
+
+BOOL VerQueryValue(LPVOID pBlock, const TCHAR* pszSubBlock, LPVOID* ppBuffer, UINT* pcbBuffer)
+{
+	VersionInfo* pvi = (VersionInfo*)pBlock;
+	if (strcmp(pszSubBlock, "\\VarFileInfo\\Translation") == 0)
+	{
+		*ppBuffer = pvi->translation;
+		*pcbBuffer = sizeof(pvi->translation);
+		return true;
+	}
+
+	// \StringFileInfo\<language><code page>\<name>, for the one translation there is
+	TCHAR szPrefix[32];
+	StringCchPrintf(szPrefix, ARRAYSIZE(szPrefix), "\\StringFileInfo\\%04x%04x\\",
+		pvi->translation[0], pvi->translation[1]);
+	size_t cchPrefix = strlen(szPrefix);
+	if (strncasecmp(pszSubBlock, szPrefix, cchPrefix) == 0)
+	{
+		const TCHAR* pszName = pszSubBlock + cchPrefix;
+		TCHAR* pszValue = NULL;
+		if (strcmp(pszName, "CompanyName") == 0) pszValue = pvi->szCompanyName;
+		else if (strcmp(pszName, "ProductName") == 0) pszValue = pvi->szProductName;
+		else if (strcmp(pszName, "ProductVersion") == 0) pszValue = pvi->szProductVersion;
+		if (pszValue)
+		{
+			*ppBuffer = pszValue;
+			*pcbBuffer = (UINT)strlen(pszValue) + 1;
+			return true;
+		}
+	}
+	errno = ENOENT;
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// The registry
+///////////////////////////////////////////////////////////////////////////////////////////////////
+struct PortableKey
+{
+	std::string path;
+};
+
+// The directory of a key - Backslashes in the subkey become directories
+static std::string KeyPath(HKEY hKey, const TCHAR* pszSubKey)
+{
+	std::string path;
+	if (hKey == HKEY_CURRENT_USER)
+	{
+		const char* pszConfig = getenv("XDG_CONFIG_HOME");
+		if (pszConfig && *pszConfig) path = pszConfig;
+		else
+		{
+			const char* pszHome = getenv("HOME");
+			path = std::string(pszHome ? pszHome : ".") + "/.config";
+		}
+	}
+	else path = hKey->path;
+	for (const TCHAR* p = pszSubKey; p && *p; ++p)
+	{
+		if (p == pszSubKey || p[-1] == '\\') path += '/';
+		if (*p != '\\') path += *p;
+	}
+	return path;
+}
+
+LSTATUS RegOpenKeyEx(HKEY hKey, const TCHAR* pszSubKey, DWORD options, REGSAM samDesired, HKEY* phkResult)
+{
+	UNREFERENCED_PARAMETER(options);
+	UNREFERENCED_PARAMETER(samDesired);
+	std::string path = KeyPath(hKey, pszSubKey);
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return ERROR_FILE_NOT_FOUND;
+	*phkResult = new PortableKey{ path };
+	return ERROR_SUCCESS;
+}
+
+LSTATUS RegCreateKeyEx(HKEY hKey, const TCHAR* pszSubKey, DWORD reserved, TCHAR* pszClass, DWORD options,
+	REGSAM samDesired, void* pSecurityAttributes, HKEY* phkResult, DWORD* pDisposition)
+{
+	UNREFERENCED_PARAMETER(reserved);
+	UNREFERENCED_PARAMETER(pszClass);
+	UNREFERENCED_PARAMETER(options);
+	UNREFERENCED_PARAMETER(samDesired);
+	UNREFERENCED_PARAMETER(pSecurityAttributes);
+	std::string path = KeyPath(hKey, pszSubKey);
+
+	// Create each directory of the path in turn
+	BOOL bCreated = false;
+	for (size_t i = 1; i <= path.size(); ++i)
+	{
+		if (i < path.size() && path[i] != '/') continue;
+		std::string dir = path.substr(0, i);
+		if (mkdir(dir.c_str(), 0700) == 0) bCreated = true;
+		else if (errno != EEXIST) return ERROR_ACCESS_DENIED;
+	}
+	if (pDisposition) *pDisposition = bCreated ? 1 : 2; // REG_CREATED_NEW_KEY, REG_OPENED_EXISTING_KEY
+	*phkResult = new PortableKey{ path };
+	return ERROR_SUCCESS;
+}
+
+LSTATUS RegQueryValueEx(HKEY hKey, const TCHAR* pszValueName, DWORD* pReserved, DWORD* pType, BYTE* pData, DWORD* pcbData)
+{
+	UNREFERENCED_PARAMETER(pReserved);
+	std::string path = hKey->path + "/" + pszValueName;
+	FILE* pFile = fopen(path.c_str(), "rb");
+	if (!pFile) return ERROR_FILE_NOT_FOUND;
+	fseek(pFile, 0, SEEK_END);
+	long cbValue = ftell(pFile);
+	fseek(pFile, 0, SEEK_SET);
+	if (pType) *pType = REG_BINARY;
+
+	// Without a buffer, only the size is asked for
+	LSTATUS ls = ERROR_SUCCESS;
+	if (pData)
+	{
+		if (!pcbData || *pcbData < (DWORD)cbValue) ls = ERROR_MORE_DATA;
+		else if (fread(pData, 1, cbValue, pFile) != (size_t)cbValue) ls = ERROR_ACCESS_DENIED;
+	}
+	if (pcbData) *pcbData = (DWORD)cbValue;
+	fclose(pFile);
+	return ls;
+}
+
+LSTATUS RegSetValueEx(HKEY hKey, const TCHAR* pszValueName, DWORD reserved, DWORD type, const BYTE* pData, DWORD cbData)
+{
+	UNREFERENCED_PARAMETER(reserved);
+	UNREFERENCED_PARAMETER(type);
+
+	// Write a temporary file and rename it, so that a value is never seen half written
+	std::string path = hKey->path + "/" + pszValueName;
+	std::string temp = path + ".tmp";
+	FILE* pFile = fopen(temp.c_str(), "wb");
+	if (!pFile) return ERROR_ACCESS_DENIED;
+	BOOL bWritten = fwrite(pData, 1, cbData, pFile) == cbData;
+	if (fclose(pFile) != 0) bWritten = false;
+	if (!bWritten || rename(temp.c_str(), path.c_str()) != 0)
+	{
+		remove(temp.c_str());
+		return ERROR_ACCESS_DENIED;
+	}
+	return ERROR_SUCCESS;
+}
+
+LSTATUS RegDeleteValue(HKEY hKey, const TCHAR* pszValueName)
+{
+	std::string path = hKey->path + "/" + pszValueName;
+	return remove(path.c_str()) == 0 ? ERROR_SUCCESS : ERROR_FILE_NOT_FOUND;
+}
+
+LSTATUS RegCloseKey(HKEY hKey)
+{
+	delete hKey;
+	return ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Bounded strings
+///////////////////////////////////////////////////////////////////////////////////////////////////
+HRESULT StringCchVPrintfEx(TCHAR* pszDest, size_t cchDest, TCHAR** ppszDestEnd, size_t* pcchRemaining,
+	DWORD flags, const TCHAR* pszFormat, va_list args)
+{
+	UNREFERENCED_PARAMETER(flags);
+	if (cchDest == 0) return STRSAFE_E_INVALID_PARAMETER;
+	int cch = vsnprintf(pszDest, cchDest, pszFormat, args);
+	size_t cchWritten = cch < 0 ? 0 : ((size_t)cch >= cchDest ? cchDest - 1 : (size_t)cch);
+	if (cch < 0) pszDest[0] = 0;
+	if (ppszDestEnd) *ppszDestEnd = pszDest + cchWritten;
+	if (pcchRemaining) *pcchRemaining = cchDest - cchWritten;
+	return (cch < 0 || (size_t)cch >= cchDest) ? STRSAFE_E_INSUFFICIENT_BUFFER : S_OK;
+}
+
+HRESULT StringCchPrintfEx(TCHAR* pszDest, size_t cchDest, TCHAR** ppszDestEnd, size_t* pcchRemaining,
+	DWORD flags, const TCHAR* pszFormat, ...)
+{
+	va_list args;
+	va_start(args, pszFormat);
+	HRESULT hr = StringCchVPrintfEx(pszDest, cchDest, ppszDestEnd, pcchRemaining, flags, pszFormat, args);
+	va_end(args);
+	return hr;
+}
+
+HRESULT StringCchPrintf(TCHAR* pszDest, size_t cchDest, const TCHAR* pszFormat, ...)
+{
+	va_list args;
+	va_start(args, pszFormat);
+	HRESULT hr = StringCchVPrintfEx(pszDest, cchDest, NULL, NULL, 0, pszFormat, args);
+	va_end(args);
+	return hr;
+}
+
+HRESULT StringCchCopy(TCHAR* pszDest, size_t cchDest, const TCHAR* pszSrc)
+{
+	if (cchDest == 0) return STRSAFE_E_INVALID_PARAMETER;
+	size_t cchSrc = strlen(pszSrc);
+	if (cchSrc >= cchDest)
+	{
+		memcpy(pszDest, pszSrc, cchDest - 1);
+		pszDest[cchDest - 1] = 0;
+		return STRSAFE_E_INSUFFICIENT_BUFFER;
+	}
+	memcpy(pszDest, pszSrc, cchSrc + 1);
+	return S_OK;
+}
+
+HRESULT StringCchCat(TCHAR* pszDest, size_t cchDest, const TCHAR* pszSrc)
+{
+	size_t cchDestLength;
+	if (FAILED(StringCchLength(pszDest, cchDest, &cchDestLength))) return STRSAFE_E_INVALID_PARAMETER;
+	return StringCchCopy(pszDest + cchDestLength, cchDest - cchDestLength, pszSrc);
+}
+
+HRESULT StringCchLength(const TCHAR* psz, size_t cchMax, size_t* pcchLength)
+{
+	if (!psz) return STRSAFE_E_INVALID_PARAMETER;
+	size_t cch = strnlen(psz, cchMax);
+	if (cch == cchMax) return STRSAFE_E_INVALID_PARAMETER;
+	if (pcchLength) *pcchLength = cch;
+	return S_OK;
+}
@@ -0,0 +1,2 @@
+#pragma once
+// SDKDDKVer.h : There is no Windows SDK version to select in the portable build.
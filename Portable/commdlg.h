@@ -0,0 +1,2 @@
+#pragma once
+// commdlg.h : The common dialogs are not part of the portable build.
@@ -0,0 +1,17 @@
+#pragma once
+// strsafe.h : The bounded string functions for the portable build - They always terminate the
+// destination and fail with STRSAFE_E_INSUFFICIENT_BUFFER when it is too small.
+
+#include "windows.h"
+
+#define STRSAFE_E_INSUFFICIENT_BUFFER ((HRESULT)0x8007007A)
+#define STRSAFE_E_INVALID_PARAMETER ((HRESULT)0x80070057)
+
+HRESULT StringCchVPrintfEx(TCHAR* pszDest, size_t cchDest, TCHAR** ppszDestEnd, size_t* pcchRemaining,
+	DWORD flags, const TCHAR* pszFormat, va_list args);
+HRESULT StringCchPrintfEx(TCHAR* pszDest, size_t cchDest, TCHAR** ppszDestEnd, size_t* pcchRemaining,
+	DWORD flags, const TCHAR* pszFormat, ...);
+HRESULT StringCchPrintf(TCHAR* pszDest, size_t cchDest, const TCHAR* pszFormat, ...);
+HRESULT StringCchCopy(TCHAR* pszDest, size_t cchDest, const TCHAR* pszSrc);
+HRESULT StringCchCat(TCHAR* pszDest, size_t cchDest, const TCHAR* pszSrc);
+HRESULT StringCchLength(const TCHAR* psz, size_t cchMax, size_t* pcchLength);
@@ -0,0 +1,32 @@
+#pragma once
+// tchar.h : Generic text mappings for the portable build, where TCHAR is char.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define _T(x) x
+#define _TEXT(x) x
+#define _tmain main
+#define _tcslen strlen
+#define _tcscmp strcmp
+#define _tcsncmp strncmp
+#define _tcsnicmp strncasecmp
+#define _tcschr strchr
+#define _tcsrchr strrchr
+#define _tcsstr strstr
+#define _tcstoul strtoul
+#define _tcstoui64 strtoull
+#define _tcstod strtod
+#define _ttoi atoi
+#define _tprintf printf
+#define _ftprintf fprintf
+#define _fgetts fgets
+
+inline int _tfopen_s(FILE** ppFile, const char* pszFileName, const char* pszMode)
+{
+	*ppFile = fopen(pszFileName, pszMode);
+	return *ppFile ? 0 : errno;
+}
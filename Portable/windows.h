@@ -0,0 +1,317 @@
+#pragma once
+// windows.h : The part of the Windows API that the portable pieces of KeyboardMouseMonitor use,
+// for building them on other platforms. Only on the include path when not building for Windows.
+//
+// TCHAR is char, so text is UTF-8. The registry is kept in files, see Portable.cpp.
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Types
+typedef int                BOOL;
+typedef unsigned char      BYTE;
+typedef unsigned short     WORD;
+typedef unsigned int       DWORD;
+typedef unsigned int       UINT;
+typedef int                LONG;
+typedef unsigned int       ULONG;
+typedef short              SHORT;
+typedef long long          LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef uintptr_t          WPARAM;
+typedef intptr_t           LPARAM;
+typedef intptr_t           LRESULT;
+typedef LONG               HRESULT;
+typedef LONG               LSTATUS;
+typedef char               TCHAR;
+typedef wchar_t            WCHAR;
+typedef BYTE*              LPBYTE;
+typedef void*              LPVOID;
+typedef void*              HANDLE;
+typedef void*              HWND;
+typedef struct PortableKey* HKEY;
+typedef DWORD              REGSAM;
+
+typedef union
+{
+	struct
+	{
+		DWORD LowPart;
+		LONG  HighPart;
+	};
+	LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef struct
+{
+	LONG x;
+	LONG y;
+} POINT;
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+#define WINAPI
+#define CALLBACK
+
+// Results
+#define S_OK ((HRESULT)0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define ERROR_SUCCESS 0L
+#define ERROR_FILE_NOT_FOUND 2L
+#define ERROR_ACCESS_DENIED 5L
+#define ERROR_MORE_DATA 234L
+#define ERROR_APP_INIT_FAILURE 575L
+
+// Macros
+#define LOWORD(l) ((WORD)(((uintptr_t)(l)) & 0xFFFF))
+#define HIWORD(l) ((WORD)((((uintptr_t)(l)) >> 16) & 0xFFFF))
+#define LOBYTE(w) ((BYTE)(((uintptr_t)(w)) & 0xFF))
+#define HIBYTE(w) ((BYTE)((((uintptr_t)(w)) >> 8) & 0xFF))
+#define MAKEWORD(a, b) ((WORD)(((BYTE)(a)) | ((WORD)((BYTE)(b))) << 8))
+#define MAKELONG(a, b) ((LONG)(((WORD)(a)) | ((DWORD)((WORD)(b))) << 16))
+#define MAKELPARAM(l, h) ((LPARAM)(DWORD)MAKELONG(l, h))
+#define MAKEWPARAM(l, h) ((WPARAM)(DWORD)MAKELONG(l, h))
+#define GET_KEYSTATE_WPARAM(wParam) (LOWORD(wParam))
+#define GET_WHEEL_DELTA_WPARAM(wParam) ((short)HIWORD(wParam))
+#define GET_XBUTTON_WPARAM(wParam) (HIWORD(wParam))
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define ZeroMemory(p, cb) memset((p), 0, (cb))
+#define UNREFERENCED_PARAMETER(p) (void)(p)
+
+// Keyboard message flags
+#define KF_EXTENDED 0x0100
+#define KF_DLGMODE 0x0800
+#define KF_MENUMODE 0x1000
+#define KF_ALTDOWN 0x2000
+#define KF_REPEAT 0x4000
+#define KF_UP 0x8000
+
+// Mouse message key state
+#define MK_LBUTTON 0x0001
+#define MK_RBUTTON 0x0002
+#define MK_SHIFT 0x0004
+#define MK_CONTROL 0x0008
+#define MK_MBUTTON 0x0010
+#define MK_XBUTTON1 0x0020
+#define MK_XBUTTON2 0x0040
+#define XBUTTON1 0x0001
+#define XBUTTON2 0x0002
+#define WHEEL_DELTA 120
+
+// Hotkey modifiers
+#define MOD_ALT 0x0001
+#define MOD_CONTROL 0x0002
+#define MOD_SHIFT 0x0004
+#define MOD_WIN 0x0008
+
+// Messages
+#define WM_KEYFIRST 0x0100
+#define WM_KEYDOWN 0x0100
+#define WM_KEYUP 0x0101
+#define WM_CHAR 0x0102
+#define WM_DEADCHAR 0x0103
+#define WM_SYSKEYDOWN 0x0104
+#define WM_SYSKEYUP 0x0105
+#define WM_SYSCHAR 0x0106
+#define WM_SYSDEADCHAR 0x0107
+#define WM_KEYLAST 0x0109
+#define WM_MOUSEFIRST 0x0200
+#define WM_MOUSEMOVE 0x0200
+#define WM_LBUTTONDOWN 0x0201
+#define WM_LBUTTONUP 0x0202
+#define WM_LBUTTONDBLCLK 0x0203
+#define WM_RBUTTONDOWN 0x0204
+#define WM_RBUTTONUP 0x0205
+#define WM_RBUTTONDBLCLK 0x0206
+#define WM_MBUTTONDOWN 0x0207
+#define WM_MBUTTONUP 0x0208
+#define WM_MBUTTONDBLCLK 0x0209
+#define WM_MOUSEWHEEL 0x020A
+#define WM_XBUTTONDOWN 0x020B
+#define WM_XBUTTONUP 0x020C
+#define WM_XBUTTONDBLCLK 0x020D
+#define WM_MOUSELAST 0x020D
+
+// Virtual key codes - Letters and digits are their ASCII codes
+#define VK_LBUTTON 0x01
+#define VK_RBUTTON 0x02
+#define VK_CANCEL 0x03
+#define VK_MBUTTON 0x04
+#define VK_XBUTTON1 0x05
+#define VK_XBUTTON2 0x06
+#define VK_BACK 0x08
+#define VK_TAB 0x09
+#define VK_CLEAR 0x0C
+#define VK_RETURN 0x0D
+#define VK_SHIFT 0x10
+#define VK_CONTROL 0x11
+#define VK_MENU 0x12
+#define VK_PAUSE 0x13
+#define VK_CAPITAL 0x14
+#define VK_KANA 0x15
+#define VK_JUNJA 0x17
+#define VK_FINAL 0x18
+#define VK_KANJI 0x19
+#define VK_ESCAPE 0x1B
+#define VK_CONVERT 0x1C
+#define VK_NONCONVERT 0x1D
+#define VK_ACCEPT 0x1E
+#define VK_MODECHANGE 0x1F
+#define VK_SPACE 0x20
+#define VK_PRIOR 0x21
+#define VK_NEXT 0x22
+#define VK_END 0x23
+#define VK_HOME 0x24
+#define VK_LEFT 0x25
+#define VK_UP 0x26
+#define VK_RIGHT 0x27
+#define VK_DOWN 0x28
+#define VK_SELECT 0x29
+#define VK_PRINT 0x2A
+#define VK_EXECUTE 0x2B
+#define VK_SNAPSHOT 0x2C
+#define VK_INSERT 0x2D
+#define VK_DELETE 0x2E
+#define VK_HELP 0x2F
+#define VK_LWIN 0x5B
+#define VK_RWIN 0x5C
+#define VK_APPS 0x5D
+#define VK_SLEEP 0x5F
+#define VK_NUMPAD0 0x60
+#define VK_NUMPAD1 0x61
+#define VK_NUMPAD2 0x62
+#define VK_NUMPAD3 0x63
+#define VK_NUMPAD4 0x64
+#define VK_NUMPAD5 0x65
+#define VK_NUMPAD6 0x66
+#define VK_NUMPAD7 0x67
+#define VK_NUMPAD8 0x68
+#define VK_NUMPAD9 0x69
+#define VK_MULTIPLY 0x6A
+#define VK_ADD 0x6B
+#define VK_SEPARATOR 0x6C
+#define VK_SUBTRACT 0x6D
+#define VK_DECIMAL 0x6E
+#define VK_DIVIDE 0x6F
+#define VK_F1 0x70
+#define VK_F2 0x71
+#define VK_F3 0x72
+#define VK_F4 0x73
+#define VK_F5 0x74
+#define VK_F6 0x75
+#define VK_F7 0x76
+#define VK_F8 0x77
+#define VK_F9 0x78
+#define VK_F10 0x79
+#define VK_F11 0x7A
+#define VK_F12 0x7B
+#define VK_F13 0x7C
+#define VK_F14 0x7D
+#define VK_F15 0x7E
+#define VK_F16 0x7F
+#define VK_F17 0x80
+#define VK_F18 0x81
+#define VK_F19 0x82
+#define VK_F20 0x83
+#define VK_F21 0x84
+#define VK_F22 0x85
+#define VK_F23 0x86
+#define VK_F24 0x87
+#define VK_NUMLOCK 0x90
+#define VK_SCROLL 0x91
+#define VK_LSHIFT 0xA0
+#define VK_RSHIFT 0xA1
+#define VK_LCONTROL 0xA2
+#define VK_RCONTROL 0xA3
+#define VK_LMENU 0xA4
+#define VK_RMENU 0xA5
+#define VK_BROWSER_BACK 0xA6
+#define VK_BROWSER_FORWARD 0xA7
+#define VK_BROWSER_REFRESH 0xA8
+#define VK_BROWSER_STOP 0xA9
+#define VK_BROWSER_SEARCH 0xAA
+#define VK_BROWSER_FAVORITES 0xAB
+#define VK_BROWSER_HOME 0xAC
+#define VK_VOLUME_MUTE 0xAD
+#define VK_VOLUME_DOWN 0xAE
+#define VK_VOLUME_UP 0xAF
+#define VK_MEDIA_NEXT_TRACK 0xB0
+#define VK_MEDIA_PREV_TRACK 0xB1
+#define VK_MEDIA_STOP 0xB2
+#define VK_MEDIA_PLAY_PAUSE 0xB3
+#define VK_LAUNCH_MAIL 0xB4
+#define VK_LAUNCH_MEDIA_SELECT 0xB5
+#define VK_LAUNCH_APP1 0xB6
+#define VK_LAUNCH_APP2 0xB7
+#define VK_OEM_1 0xBA
+#define VK_OEM_PLUS 0xBB
+#define VK_OEM_COMMA 0xBC
+#define VK_OEM_MINUS 0xBD
+#define VK_OEM_PERIOD 0xBE
+#define VK_OEM_2 0xBF
+#define VK_OEM_3 0xC0
+#define VK_OEM_4 0xDB
+#define VK_OEM_5 0xDC
+#define VK_OEM_6 0xDD
+#define VK_OEM_7 0xDE
+#define VK_OEM_8 0xDF
+#define VK_OEM_102 0xE2
+#define VK_PROCESSKEY 0xE5
+#define VK_PACKET 0xE7
+#define VK_ATTN 0xF6
+#define VK_CRSEL 0xF7
+#define VK_EXSEL 0xF8
+#define VK_EREOF 0xF9
+#define VK_PLAY 0xFA
+#define VK_ZOOM 0xFB
+#define VK_NONAME 0xFC
+#define VK_PA1 0xFD
+#define VK_OEM_CLEAR 0xFE
+
+// Message boxes
+#define MB_OK 0x00000000L
+#define MB_ICONSTOP 0x00000010L
+#define MB_ICONEXCLAMATION 0x00000030L
+#define MB_ICONINFORMATION 0x00000040L
+#define IDOK 1
+
+// Registry
+#define HKEY_CURRENT_USER ((HKEY)(uintptr_t)0x80000001)
+#define KEY_READ 0x20019
+#define KEY_WRITE 0x20006
+#define REG_OPTION_NON_VOLATILE 0x00000000L
+#define REG_BINARY 3
+
+// Time
+BOOL QueryPerformanceCounter(LARGE_INTEGER* pCounter);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* pFrequency);
+
+// Strings
+inline int lstrlen(const TCHAR* psz) { return psz ? (int)strlen(psz) : 0; }
+
+// Errors and messages
+DWORD GetLastError();
+int MessageBox(HWND hWnd, const TCHAR* pszText, const TCHAR* pszCaption, UINT type);
+BOOL MessageBeep(UINT type);
+
+// Modules and their version resource - The version strings are given to the build
+DWORD GetModuleFileName(HANDLE hModule, TCHAR* pszFileName, DWORD cchFileName);
+DWORD GetFileVersionInfoSize(const TCHAR* pszFileName, DWORD* pHandle);
+BOOL GetFileVersionInfo(const TCHAR* pszFileName, DWORD handle, DWORD cbData, LPVOID pData);
+BOOL VerQueryValue(LPVOID pBlock, const TCHAR* pszSubBlock, LPVOID* ppBuffer, UINT* pcbBuffer);
+
+// The registry, kept in files under $XDG_CONFIG_HOME or ~/.config
+LSTATUS RegOpenKeyEx(HKEY hKey, const TCHAR* pszSubKey, DWORD options, REGSAM samDesired, HKEY* phkResult);
+LSTATUS RegCreateKeyEx(HKEY hKey, const TCHAR* pszSubKey, DWORD reserved, TCHAR* pszClass, DWORD options,
+	REGSAM samDesired, void* pSecurityAttributes, HKEY* phkResult, DWORD* pDisposition);
+LSTATUS RegQueryValueEx(HKEY hKey, const TCHAR* pszValueName, DWORD* pReserved, DWORD* pType, BYTE* pData, DWORD* pcbData);
+LSTATUS RegSetValueEx(HKEY hKey, const TCHAR* pszValueName, DWORD reserved, DWORD type, const BYTE* pData, DWORD cbData);
+LSTATUS RegDeleteValue(HKEY hKey, const TCHAR* pszValueName);
+LSTATUS RegCloseKey(HKEY hKey);
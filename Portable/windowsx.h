@@ -0,0 +1,7 @@
+#pragma once
+// windowsx.h : Message cracker macros for the portable build.
+
+#include "windows.h"
+
+#define GET_X_LPARAM(lp) ((int)(short)LOWORD(lp))
+#define GET_Y_LPARAM(lp) ((int)(short)HIWORD(lp))